@@ -0,0 +1,110 @@
+#include "axis_sliders.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "line_renderer.h"
+
+static const float slider_left = 0.1f;
+static const float slider_right = 0.9f;
+static const float slider_bottom = 0.03f;
+static const float slider_spacing = 0.04f;
+static const float slider_grab = 0.015f;  // vertical distance at which a slider can be grabbed
+static const float slider_steps = 200.f;
+static const float knob_size = 10.f;      // pixels
+
+AxisSliders::AxisSliders(const std::vector<VariationAxis>& axes): axes(axes), dragged(-1) {
+    for (const VariationAxis& axis : axes) {
+        values.push_back(axis.default_value);
+    }
+}
+
+float AxisSliders::rowY(size_t axis) const {
+    return slider_bottom + (float)axis * slider_spacing;
+}
+
+float AxisSliders::position(size_t axis) const {
+    const VariationAxis& a = axes[axis];
+    float t = a.maximum > a.minimum ? (values[axis] - a.minimum) / (a.maximum - a.minimum) : 0.f;
+    return slider_left + t * (slider_right - slider_left);
+}
+
+float AxisSliders::valueAt(size_t axis, float x) const {
+    const VariationAxis& a = axes[axis];
+    float t = std::clamp((x - slider_left) / (slider_right - slider_left), 0.f, 1.f);
+    float value = a.minimum + std::round(t * slider_steps) / slider_steps * (a.maximum - a.minimum);
+
+    // the default is rarely on a step, snap to it when close
+    if (std::abs(value - a.default_value) <= (a.maximum - a.minimum) / slider_steps) {
+        value = a.default_value;
+    }
+    return value;
+}
+
+bool AxisSliders::press(glm::vec2 p) {
+    for (size_t i = 0; i < axes.size(); i++) {
+        if (std::abs(p.y - rowY(i)) <= slider_grab && p.x >= slider_left - slider_grab && p.x <= slider_right + slider_grab) {
+            dragged = (int)i;
+            drag(p);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AxisSliders::drag(glm::vec2 p) {
+    if (dragged < 0) return false;
+
+    float value = valueAt(dragged, p.x);
+    if (value == values[dragged]) return false;
+    values[dragged] = value;
+    return true;
+}
+
+std::vector<FT_Fixed> AxisSliders::coords() const {
+    std::vector<FT_Fixed> coords;
+    bool is_default = true;
+    for (size_t i = 0; i < axes.size(); i++) {
+        coords.push_back((FT_Fixed)std::lround(values[i] * 65536.f));
+        is_default = is_default && values[i] == axes[i].default_value;
+    }
+    if (is_default) coords.clear();
+    return coords;
+}
+
+std::string AxisSliders::describe() const {
+    std::string text;
+    for (size_t i = 0; i < axes.size(); i++) {
+        char tag[5] = {(char)(axes[i].tag >> 24), (char)(axes[i].tag >> 16), (char)(axes[i].tag >> 8), (char)axes[i].tag, 0};
+        char item[32];
+        std::snprintf(item, sizeof(item), "%s%s %g", i ? "  " : "", tag, values[i]);
+        text += item;
+    }
+    return text;
+}
+
+void AxisSliders::draw(LineRenderer& renderer) const {
+    std::vector<glm::vec2> tracks, knobs;
+    for (size_t i = 0; i < axes.size(); i++) {
+        float y = rowY(i);
+        tracks.push_back(glm::vec2(slider_left, y));
+        tracks.push_back(glm::vec2(slider_right, y));
+
+        // tick on the default value
+        const VariationAxis& a = axes[i];
+        float t = a.maximum > a.minimum ? (a.default_value - a.minimum) / (a.maximum - a.minimum) : 0.f;
+        float x = slider_left + t * (slider_right - slider_left);
+        tracks.push_back(glm::vec2(x, y - slider_grab / 2));
+        tracks.push_back(glm::vec2(x, y + slider_grab / 2));
+
+        knobs.push_back(glm::vec2(position(i), y));
+    }
+
+    renderer.setView(glm::vec2(1, 1), glm::vec2(0, 0));
+    renderer.drawLines(tracks, glm::vec2(0, 0), glm::vec4(0.6f, 0.6f, 0.6f, 1.f));
+    renderer.drawMarkers(knobs, glm::vec2(0, 0), knob_size, glm::vec4(0.2f, 0.2f, 0.2f, 1.f), true);
+    if (dragged >= 0) {
+        renderer.drawMarkers({knobs[dragged]}, glm::vec2(0, 0), knob_size, glm::vec4(1.f, 0.6f, 0.f, 1.f), true);
+    }
+}
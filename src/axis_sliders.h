@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include "glm/vec2.hpp"
+#include "variations.h"
+
+class LineRenderer;
+
+// One horizontal slider per variation axis along the bottom of the window.
+// Positions are in the [0, 1] window square, y going up. Values are snapped
+// to a fixed number of steps so that dragging comes back to instances that
+// are already cached.
+class AxisSliders {
+public:
+    explicit AxisSliders(const std::vector<VariationAxis>& axes);
+
+    // Starts dragging the slider under p, returns false if there is none
+    bool press(glm::vec2 p);
+    void release() { dragged = -1; }
+    bool dragging() const { return dragged >= 0; }
+    // Moves the dragged slider to p, returns true if its value changed
+    bool drag(glm::vec2 p);
+
+    // Design coordinates in 16.16, empty when every axis is at its default
+    std::vector<FT_Fixed> coords() const;
+    // Axis tags and values, for the window title
+    std::string describe() const;
+
+    // Draws in window space, the view of the renderer is reset
+    void draw(LineRenderer& renderer) const;
+
+private:
+    float valueAt(size_t axis, float x) const;
+    float position(size_t axis) const;
+    float rowY(size_t axis) const;
+
+    std::vector<VariationAxis> axes;
+    std::vector<float> values;
+    int dragged;
+};
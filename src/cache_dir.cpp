@@ -0,0 +1,34 @@
+#include "cache_dir.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <sys/stat.h>
+
+static bool make_directory(const std::string& path) {
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+uint64_t hash_bytes(const char* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string cache_directory() {
+    std::string base;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        base = xdg;
+    } else if (const char* home = std::getenv("HOME"); home && *home) {
+        base = std::string(home) + "/.cache";
+        if (!make_directory(base)) return "";
+    } else {
+        return "";
+    }
+
+    std::string dir = base + "/fontvis";
+    if (!make_directory(dir)) return "";
+    return dir;
+}
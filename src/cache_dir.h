@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// $XDG_CACHE_HOME/fontvis or ~/.cache/fontvis, created if needed.
+// Returns an empty string if no cache directory is available.
+std::string cache_directory();
+
+// FNV-1a, used to key cache files
+uint64_t hash_bytes(const char* data, size_t size);
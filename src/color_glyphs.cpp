@@ -0,0 +1,64 @@
+#include "color_glyphs.h"
+
+#include FT_BITMAP_H
+#include FT_COLOR_H
+#include "glyph_atlas.h"
+
+// layers with this palette index use the text color
+static const FT_UShort foreground_color = 0xFFFF;
+
+bool color_layers(FT_Face face, unsigned int glyph_index, std::vector<ColorLayer>& layers) {
+    layers.clear();
+    if (!FT_HAS_COLOR(face)) return false;
+
+    FT_Color* palette = nullptr;
+    FT_Palette_Data palettes;
+    if (!FT_Palette_Data_Get(face, &palettes) && palettes.num_palettes > 0) {
+        FT_Palette_Select(face, 0, &palette);
+    }
+
+    FT_UInt layer_glyph, color_index;
+    FT_LayerIterator iterator;
+    iterator.p = nullptr;
+    while (FT_Get_Color_Glyph_Layer(face, glyph_index, &layer_glyph, &color_index, &iterator)) {
+        glm::vec4 color(0, 0, 0, 1);
+        if (color_index != foreground_color && palette && color_index < palettes.num_palette_entries) {
+            const FT_Color& c = palette[color_index];
+            color = glm::vec4(c.red, c.green, c.blue, c.alpha) / 255.f;
+        }
+        layers.push_back(ColorLayer{layer_glyph, color});
+    }
+    return !layers.empty();
+}
+
+bool has_bitmap(FT_Face face, unsigned int glyph_index) {
+    if (!FT_HAS_FIXED_SIZES(face) && !FT_HAS_SBIX(face)) return false;
+    return !FT_Load_Glyph(face, glyph_index, FT_LOAD_COLOR) && face->glyph->format == FT_GLYPH_FORMAT_BITMAP;
+}
+
+const AtlasEntry* rasterize_bitmap(GlyphAtlas& atlas, FT_Face face, unsigned int glyph_index) {
+    if (FT_Load_Glyph(face, glyph_index, FT_LOAD_COLOR) || face->glyph->format != FT_GLYPH_FORMAT_BITMAP) return nullptr;
+
+    const FT_Bitmap& bitmap = face->glyph->bitmap;
+    if (bitmap.pixel_mode == FT_PIXEL_MODE_BGRA) {
+        return atlas.insert(glyph_index, bitmap.buffer, bitmap.width, bitmap.rows, bitmap.pitch,
+                            face->glyph->bitmap_left, face->glyph->bitmap_top);
+    }
+
+    // other depths go through 8-bit coverage, drawn as black with that alpha
+    FT_Bitmap gray;
+    FT_Bitmap_Init(&gray);
+    if (FT_Bitmap_Convert(face->glyph->library, &bitmap, &gray, 1)) return nullptr;
+
+    int levels = gray.num_grays > 1 ? gray.num_grays - 1 : 1;
+    std::vector<unsigned char> bgra(gray.width * gray.rows * 4, 0);
+    for (unsigned int y = 0; y < gray.rows; y++) {
+        for (unsigned int x = 0; x < gray.width; x++) {
+            bgra[(y*gray.width + x)*4 + 3] = (unsigned char)(gray.buffer[y*gray.pitch + x] * 255 / levels);
+        }
+    }
+    const AtlasEntry* entry = atlas.insert(glyph_index, bgra.data(), gray.width, gray.rows, gray.width*4,
+                                           face->glyph->bitmap_left, face->glyph->bitmap_top);
+    FT_Bitmap_Done(face->glyph->library, &gray);
+    return entry;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include "glm/vec4.hpp"
+
+class GlyphAtlas;
+struct AtlasEntry;
+
+struct ColorLayer {
+    unsigned int glyph_index;  // outline glyph drawn for the layer
+    glm::vec4 color;
+};
+
+// COLR layers of the glyph from bottom to top with the colors of the first
+// palette. Returns false if the glyph is not a layered color glyph.
+bool color_layers(FT_Face face, unsigned int glyph_index, std::vector<ColorLayer>& layers);
+
+// True if the face stores a bitmap for the glyph at the current size (sbix, CBDT, EBDT)
+bool has_bitmap(FT_Face face, unsigned int glyph_index);
+
+// Inserts the bitmap of the glyph into a four channel atlas, monochrome
+// bitmaps being drawn in black. Returns nullptr if there is none or it does not fit.
+const AtlasEntry* rasterize_bitmap(GlyphAtlas& atlas, FT_Face face, unsigned int glyph_index);
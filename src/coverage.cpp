@@ -0,0 +1,86 @@
+#include "coverage.h"
+
+#include <algorithm>
+
+static const uint32_t n_unicode_blocks = 0x110000 / 256;
+
+static bool block_contains(const CoverageBlock& block, uint32_t c) {
+    return (block.bits[(c >> 6) & 3] >> (c & 63)) & 1;
+}
+
+Coverage::Coverage(): slots(n_unicode_blocks, 0), n_codepoints(0) {}
+
+Coverage::Coverage(FT_Face face): Coverage() {
+    if (FT_Select_Charmap(face, FT_ENCODING_UNICODE)) return;
+
+    // the charmap is walked in increasing order, so blocks are appended sorted
+    FT_UInt glyph_index;
+    FT_ULong c = FT_Get_First_Char(face, &glyph_index);
+    while (glyph_index != 0) {
+        add((uint32_t)c);
+        c = FT_Get_Next_Char(face, c, &glyph_index);
+    }
+}
+
+void Coverage::add(uint32_t c) {
+    uint32_t block = c >> 8;
+    if (block >= n_unicode_blocks) return;
+
+    if (slots[block] == 0) {
+        stored.push_back(CoverageBlock{block, 0, {0, 0, 0, 0}});
+        slots[block] = (uint16_t)stored.size();
+    }
+    CoverageBlock& bits = stored[slots[block] - 1];
+    if (!block_contains(bits, c)) {
+        bits.bits[(c >> 6) & 3] |= uint64_t(1) << (c & 63);
+        n_codepoints++;
+    }
+}
+
+bool Coverage::contains(uint32_t c) const {
+    uint32_t block = c >> 8;
+    if (block >= n_unicode_blocks || slots[block] == 0) return false;
+    return block_contains(stored[slots[block] - 1], c);
+}
+
+bool Coverage::next(uint32_t c, uint32_t& found) const {
+    auto it = std::lower_bound(stored.begin(), stored.end(), (c + 1) >> 8, [](const CoverageBlock& block, uint32_t b) {
+        return block.block < b;
+    });
+    for (; it != stored.end(); ++it) {
+        uint32_t first = std::max(it->block << 8, c + 1);
+        for (uint32_t p = first; p < (it->block + 1) << 8; p++) {
+            if (block_contains(*it, p)) {
+                found = p;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool Coverage::previous(uint32_t c, uint32_t& found) const {
+    if (c == 0) return false;
+    auto it = std::upper_bound(stored.begin(), stored.end(), (c - 1) >> 8, [](uint32_t b, const CoverageBlock& block) {
+        return b < block.block;
+    });
+    while (it != stored.begin()) {
+        --it;
+        uint32_t last = std::min(((it->block + 1) << 8) - 1, c - 1);
+        for (uint32_t p = last + 1; p-- > it->block << 8;) {
+            if (block_contains(*it, p)) {
+                found = p;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool Coverage::contains(const CoverageBlock* blocks, size_t n_blocks, uint32_t c) {
+    const CoverageBlock* end = blocks + n_blocks;
+    const CoverageBlock* it = std::lower_bound(blocks, end, c >> 8, [](const CoverageBlock& block, uint32_t b) {
+        return block.block < b;
+    });
+    return it != end && it->block == c >> 8 && block_contains(*it, c);
+}
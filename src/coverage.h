@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+
+// Bits of 256 consecutive codepoints, as stored in the font index
+struct CoverageBlock {
+    uint32_t block;  // first codepoint / 256
+    uint32_t reserved;
+    uint64_t bits[4];
+};
+
+// Codepoints mapped to a glyph by a face, as a sparse bitset over Unicode.
+// Only the blocks of 256 codepoints with at least one of them are stored,
+// and a table over every block of the 17 planes finds them in O(1).
+class Coverage {
+public:
+    Coverage();
+    // Codepoints of the Unicode charmap of the face, empty without one
+    explicit Coverage(FT_Face face);
+
+    bool contains(uint32_t c) const;
+    size_t count() const { return n_codepoints; }
+
+    // Nearest covered codepoint after or before c, returns false if there is none
+    bool next(uint32_t c, uint32_t& found) const;
+    bool previous(uint32_t c, uint32_t& found) const;
+
+    // Sorted by block
+    const std::vector<CoverageBlock>& blocks() const { return stored; }
+
+    // Lookup in sorted blocks without building the table, for the index
+    static bool contains(const CoverageBlock* blocks, size_t n_blocks, uint32_t c);
+
+private:
+    void add(uint32_t c);
+
+    std::vector<CoverageBlock> stored;
+    std::vector<uint16_t> slots;  // per block, 1 + its index in stored, 0 when empty
+    size_t n_codepoints;
+};
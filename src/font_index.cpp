@@ -0,0 +1,278 @@
+#include "font_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include "cache_dir.h"
+
+static const char index_magic[4] = {'F', 'V', 'F', 'I'};
+static const uint32_t index_version = 2;
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t n_faces;
+    uint32_t n_blocks;
+    uint64_t strings_size;
+};
+
+// Face being indexed, before its strings and coverage are packed into tables
+struct ScannedFace {
+    std::string path, family, style;
+    uint32_t face_index, n_glyphs, flags;
+    int64_t mtime;
+    uint64_t file_size;
+    std::vector<CoverageBlock> blocks;
+};
+
+struct FontFile {
+    std::string path;
+    int64_t mtime;
+    uint64_t size;
+};
+
+static const char* font_extensions[] = {".ttf", ".otf", ".ttc", ".otc", ".woff", ".woff2"};
+
+FontIndex::FontIndex(): n_faces(0), faces(nullptr), block_table(nullptr), strings(nullptr) {}
+
+bool FontIndex::open(const std::string& path) {
+    if (!file.open(path.c_str()) || file.size() < sizeof(IndexHeader)) return false;
+
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(file.data());
+    if (std::memcmp(header->magic, index_magic, sizeof(index_magic)) != 0 || header->version != index_version) return false;
+
+    size_t faces_offset = sizeof(IndexHeader);
+    size_t blocks_offset = faces_offset + (size_t)header->n_faces*sizeof(IndexedFace);
+    size_t strings_offset = blocks_offset + (size_t)header->n_blocks*sizeof(CoverageBlock);
+    if (strings_offset > file.size() || file.size() - strings_offset != header->strings_size) return false;
+
+    // every record must point inside the tables, and the last string must be terminated
+    const IndexedFace* records = reinterpret_cast<const IndexedFace*>(file.data() + faces_offset);
+    const char* string_table = file.data() + strings_offset;
+    if (header->n_faces > 0 && (header->strings_size == 0 || string_table[header->strings_size - 1] != '\0')) return false;
+    for (size_t i = 0; i < header->n_faces; i++) {
+        const IndexedFace& face = records[i];
+        if (face.path >= header->strings_size || face.family >= header->strings_size || face.style >= header->strings_size) return false;
+        if ((uint64_t)face.first_block + face.n_blocks > header->n_blocks) return false;
+    }
+
+    n_faces = header->n_faces;
+    faces = records;
+    block_table = reinterpret_cast<const CoverageBlock*>(file.data() + blocks_offset);
+    strings = string_table;
+    return true;
+}
+
+static bool equal_ignoring_case(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower((unsigned char)x) == std::tolower((unsigned char)y);
+    });
+}
+
+const IndexedFace* FontIndex::find(const std::string& name) const {
+    const IndexedFace* family_match = nullptr;
+    for (size_t i = 0; i < n_faces; i++) {
+        std::string family = string(faces[i].family);
+        if (equal_ignoring_case(family + " " + string(faces[i].style), name)) return &faces[i];
+        if (!family_match && equal_ignoring_case(family, name)) family_match = &faces[i];
+    }
+    return family_match;
+}
+
+bool FontIndex::covers(const IndexedFace& face, const std::vector<uint32_t>& codepoints) const {
+    return std::all_of(codepoints.begin(), codepoints.end(), [&](uint32_t c) {
+        return Coverage::contains(blocks(face), face.n_blocks, c);
+    });
+}
+
+std::string font_index_path() {
+    std::string dir = cache_directory();
+    return dir.empty() ? dir : dir + "/fonts.index";
+}
+
+static void scan_file(FT_Library ft_lib, const FontFile& file, std::vector<ScannedFace>& scanned) {
+    FT_Long n_faces = 1;
+    for (FT_Long i = 0; i < n_faces; i++) {
+        FT_Face face;
+        if (FT_New_Face(ft_lib, file.path.c_str(), i, &face)) return;
+        // collections tell their face count in every face
+        n_faces = face->num_faces;
+
+        ScannedFace entry;
+        entry.path = file.path;
+        entry.family = face->family_name ? face->family_name : "";
+        entry.style = face->style_name ? face->style_name : "";
+        entry.face_index = (uint32_t)i;
+        entry.n_glyphs = (uint32_t)face->num_glyphs;
+        entry.flags = FT_IS_SCALABLE(face) ? FontIndex::scalable : 0;
+        entry.mtime = file.mtime;
+        entry.file_size = file.size;
+        entry.blocks = Coverage(face).blocks();
+        scanned.push_back(std::move(entry));
+
+        FT_Done_Face(face);
+    }
+}
+
+static std::vector<FontFile> list_font_files(const std::string& dir) {
+    namespace fs = std::filesystem;
+    std::vector<FontFile> files;
+    std::error_code err;
+    fs::recursive_directory_iterator it(dir, fs::directory_options::skip_permission_denied, err);
+    for (; !err && it != fs::recursive_directory_iterator(); it.increment(err)) {
+        if (!it->is_regular_file(err)) continue;
+
+        std::string extension = it->path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (std::find(std::begin(font_extensions), std::end(font_extensions), extension) == std::end(font_extensions)) continue;
+
+        FontFile file;
+        file.path = fs::absolute(it->path(), err).lexically_normal().string();
+        file.size = it->file_size(err);
+        file.mtime = std::chrono::duration_cast<std::chrono::seconds>(it->last_write_time(err).time_since_epoch()).count();
+        files.push_back(std::move(file));
+    }
+    return files;
+}
+
+static bool write_index(const std::string& path, const std::vector<ScannedFace>& scanned) {
+    std::vector<IndexedFace> faces;
+    std::vector<CoverageBlock> blocks;
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> string_offsets;
+    auto add_string = [&](const std::string& s) {
+        auto it = string_offsets.find(s);
+        if (it != string_offsets.end()) return it->second;
+        uint32_t offset = (uint32_t)strings.size();
+        strings.append(s.c_str(), s.size() + 1);
+        string_offsets[s] = offset;
+        return offset;
+    };
+
+    for (const ScannedFace& entry : scanned) {
+        IndexedFace face;
+        face.path = add_string(entry.path);
+        face.family = add_string(entry.family);
+        face.style = add_string(entry.style);
+        face.face_index = entry.face_index;
+        face.n_glyphs = entry.n_glyphs;
+        face.flags = entry.flags;
+        face.mtime = entry.mtime;
+        face.file_size = entry.file_size;
+        face.first_block = (uint32_t)blocks.size();
+        face.n_blocks = (uint32_t)entry.blocks.size();
+        blocks.insert(blocks.end(), entry.blocks.begin(), entry.blocks.end());
+        faces.push_back(face);
+    }
+
+    IndexHeader header;
+    std::memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.version = index_version;
+    header.n_faces = (uint32_t)faces.size();
+    header.n_blocks = (uint32_t)blocks.size();
+    header.strings_size = strings.size();
+
+    // written aside and renamed so that a viewer mapping the old index is not disturbed
+    std::string temp_path = path + ".tmp";
+    FILE* f = std::fopen(temp_path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && std::fwrite(faces.data(), sizeof(IndexedFace), faces.size(), f) == faces.size();
+    ok = ok && std::fwrite(blocks.data(), sizeof(CoverageBlock), blocks.size(), f) == blocks.size();
+    ok = ok && std::fwrite(strings.data(), 1, strings.size(), f) == strings.size();
+    ok = std::fclose(f) == 0 && ok;
+    return ok && std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+static ScannedFace previous_entry(const FontIndex& previous, const IndexedFace& face) {
+    return ScannedFace{previous.string(face.path), previous.string(face.family), previous.string(face.style),
+                       face.face_index, face.n_glyphs, face.flags, face.mtime, face.file_size,
+                       std::vector<CoverageBlock>(previous.blocks(face), previous.blocks(face) + face.n_blocks)};
+}
+
+bool scan_font_directory(const std::string& dir, const std::string& index_path, unsigned int n_threads, ScanStats& stats) {
+    std::vector<FontFile> files = list_font_files(dir);
+    std::error_code err;
+    std::string prefix = (std::filesystem::absolute(dir, err).lexically_normal() / "").string();
+
+    // records of the previous index by file, for the files that have not changed,
+    // and the faces of other directories which are kept as they are
+    FontIndex previous;
+    std::unordered_map<std::string, std::vector<const IndexedFace*>> previous_files;
+    std::vector<const IndexedFace*> other_faces;
+    if (previous.open(index_path)) {
+        for (size_t i = 0; i < previous.size(); i++) {
+            std::string path = previous.string(previous.face(i).path);
+            if (path.compare(0, prefix.size(), prefix) == 0) {
+                previous_files[path].push_back(&previous.face(i));
+            } else {
+                other_faces.push_back(&previous.face(i));
+            }
+        }
+    }
+
+    std::atomic<size_t> next_file(0), n_unchanged(0);
+    std::vector<std::vector<ScannedFace>> scanned(std::max(n_threads, 1u));
+    auto work = [&](std::vector<ScannedFace>& out) {
+        FT_Library ft_lib;
+        if (FT_Init_FreeType(&ft_lib)) return;
+
+        for (size_t i = next_file++; i < files.size(); i = next_file++) {
+            const FontFile& file = files[i];
+            auto it = previous_files.find(file.path);
+            if (it != previous_files.end() && it->second[0]->mtime == file.mtime && it->second[0]->file_size == file.size) {
+                for (const IndexedFace* face : it->second) {
+                    out.push_back(previous_entry(previous, *face));
+                }
+                n_unchanged++;
+                continue;
+            }
+            scan_file(ft_lib, file, out);
+        }
+
+        FT_Done_FreeType(ft_lib);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < scanned.size(); t++) {
+        threads.emplace_back(work, std::ref(scanned[t]));
+    }
+    work(scanned[0]);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<ScannedFace> faces;
+    for (std::vector<ScannedFace>& part : scanned) {
+        std::move(part.begin(), part.end(), std::back_inserter(faces));
+    }
+    stats.n_faces = faces.size();
+    for (const IndexedFace* face : other_faces) {
+        faces.push_back(previous_entry(previous, *face));
+    }
+    std::sort(faces.begin(), faces.end(), [](const ScannedFace& a, const ScannedFace& b) {
+        return a.path != b.path ? a.path < b.path : a.face_index < b.face_index;
+    });
+
+    stats.n_files = files.size();
+    stats.n_unchanged = n_unchanged;
+    stats.n_kept = other_faces.size();
+
+    if (!write_index(index_path, faces)) {
+        std::cerr << "Failed to write the font index " << index_path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "coverage.h"
+#include "mapped_file.h"
+
+// Record of one face in the index file, strings being offsets into its string table
+struct IndexedFace {
+    uint32_t path, family, style;
+    uint32_t face_index;
+    uint32_t n_glyphs;
+    uint32_t flags;
+    int64_t mtime;  // of the file, in seconds
+    uint64_t file_size;
+    // codepoints covered, as sorted blocks of the block table
+    uint32_t first_block, n_blocks;
+};
+
+// Faces of every font file found by scan_font_directory. The file is mapped
+// and records are read in place, so opening a font by name does not touch
+// the fonts themselves.
+class FontIndex {
+public:
+    static const uint32_t scalable = 1;
+
+    FontIndex();
+
+    // Returns false if the file is missing, is not an index of this version or
+    // has a record pointing outside its tables
+    bool open(const std::string& path);
+
+    size_t size() const { return n_faces; }
+    const IndexedFace& face(size_t i) const { return faces[i]; }
+    const char* string(uint32_t offset) const { return strings + offset; }
+    const CoverageBlock* blocks(const IndexedFace& face) const { return block_table + face.first_block; }
+
+    // Face whose "family style" or, failing that, family is name, ignoring case
+    const IndexedFace* find(const std::string& name) const;
+    // True if the face has a glyph for every codepoint
+    bool covers(const IndexedFace& face, const std::vector<uint32_t>& codepoints) const;
+
+private:
+    MappedFile file;
+    size_t n_faces;
+    const IndexedFace* faces;
+    const CoverageBlock* block_table;
+    const char* strings;
+};
+
+struct ScanStats {
+    size_t n_files, n_faces;
+    size_t n_unchanged;  // files whose records were taken from the previous index
+    size_t n_kept;       // faces of other directories carried over from the previous index
+};
+
+// Index in the cache directory, empty if there is none
+std::string font_index_path();
+
+// Opens every font file under dir with n_threads workers, each with its own
+// FreeType library, and replaces its faces in the index at index_path. Faces
+// of other directories stay in the index. Files whose size and modification
+// time match the previous index are not opened again.
+bool scan_font_directory(const std::string& dir, const std::string& index_path, unsigned int n_threads, ScanStats& stats);
@@ -0,0 +1,36 @@
+#include "font_set.h"
+
+FontSet::FontSet(FT_Library ft_lib): ft_lib(ft_lib) {}
+
+FontSet::~FontSet() {
+    for (const FontFace& face : faces) {
+        FT_Done_Face(face.face);
+    }
+}
+
+bool FontSet::open(const char* path, long face_index) {
+    auto file = std::make_unique<MappedFile>();
+    if (!file->open(path)) return false;
+
+    const FT_Byte* data = reinterpret_cast<const FT_Byte*>(file->data());
+    FT_Face face;
+    if (face_index >= 0) {
+        if (FT_New_Memory_Face(ft_lib, data, file->size(), face_index, &face)) return false;
+        faces.push_back(FontFace{face, file.get(), path, (unsigned int)face_index});
+        files.push_back(std::move(file));
+        return true;
+    }
+
+    if (FT_New_Memory_Face(ft_lib, data, file->size(), 0, &face)) return false;
+
+    // single fonts have one face, collections tell their count in the first one
+    FT_Long n_faces = face->num_faces;
+    faces.push_back(FontFace{face, file.get(), path, 0});
+    for (FT_Long i = 1; i < n_faces; i++) {
+        if (FT_New_Memory_Face(ft_lib, data, file->size(), i, &face)) continue;
+        faces.push_back(FontFace{face, file.get(), path, (unsigned int)i});
+    }
+
+    files.push_back(std::move(file));
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include "mapped_file.h"
+
+struct FontFace {
+    FT_Face face;
+    const MappedFile* file;
+    std::string path;
+    unsigned int index;  // in the collection
+};
+
+// Every face of the font files opened so far. Each file is mapped once and
+// FreeType reads its faces in place, so the faces of a collection (TTC/OTC)
+// and the background workers opening them share the same mapping.
+class FontSet {
+public:
+    explicit FontSet(FT_Library ft_lib);
+    ~FontSet();
+
+    FontSet(const FontSet&) = delete;
+    FontSet& operator=(const FontSet&) = delete;
+
+    // Maps the file and opens the given face, or all its faces when face_index
+    // is negative. Returns false if it is not a font or has no such face.
+    bool open(const char* path, long face_index = -1);
+
+    size_t size() const { return faces.size(); }
+    const FontFace& operator[](size_t i) const { return faces[i]; }
+
+private:
+    FT_Library ft_lib;
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<FontFace> faces;
+};
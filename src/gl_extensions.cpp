@@ -0,0 +1,47 @@
+#include "gl_extensions.h"
+
+#include <cstring>
+
+GLExtensions gl_ext;
+
+bool has_gl_extension(const char* name) {
+    int n_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n_extensions);
+    for (int i = 0; i < n_extensions; i++) {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension && !std::strcmp(extension, name)) return true;
+    }
+    return false;
+}
+
+static bool has_gl_version(int major, int minor) {
+    int context_major = 0, context_minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+    glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+    return context_major > major || (context_major == major && context_minor >= minor);
+}
+
+void load_gl_extensions(GLADloadfunc load) {
+    gl_ext = GLExtensions();
+
+    if (has_gl_version(4, 1) || has_gl_extension("GL_ARB_get_program_binary")) {
+        gl_ext.GetProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(load("glGetProgramBinary"));
+        gl_ext.ProgramBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(load("glProgramBinary"));
+        gl_ext.ProgramParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(load("glProgramParameteri"));
+
+        int n_formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+        gl_ext.program_binary = gl_ext.GetProgramBinary && gl_ext.ProgramBinary && gl_ext.ProgramParameteri && n_formats > 0;
+    }
+
+    bool base_instance = has_gl_version(4, 2) || has_gl_extension("GL_ARB_base_instance");
+    if (has_gl_version(4, 3) || (base_instance && has_gl_extension("GL_ARB_multi_draw_indirect"))) {
+        gl_ext.MultiDrawElementsIndirect = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTPROC>(load("glMultiDrawElementsIndirect"));
+        gl_ext.multi_draw_indirect = gl_ext.MultiDrawElementsIndirect != nullptr;
+    }
+
+    if (has_gl_version(4, 4) || has_gl_extension("GL_ARB_buffer_storage")) {
+        gl_ext.BufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(load("glBufferStorage"));
+        gl_ext.buffer_storage = gl_ext.BufferStorage != nullptr;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "glad.h"
+
+// Entry points beyond the GL 3.3 core profile covered by glad, loaded when
+// the context supports them. Callers check the feature flags before use.
+
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+
+typedef void (GLAD_API_PTR *PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (GLAD_API_PTR *PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (GLAD_API_PTR *PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (GLAD_API_PTR *PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef void (GLAD_API_PTR *PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// Layout of the commands read from GL_DRAW_INDIRECT_BUFFER by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+struct GLExtensions {
+    bool program_binary;
+    PFNGLGETPROGRAMBINARYPROC GetProgramBinary;
+    PFNGLPROGRAMBINARYPROC ProgramBinary;
+    PFNGLPROGRAMPARAMETERIPROC ProgramParameteri;
+
+    // with base instances, so that each command reads its own per-instance attributes
+    bool multi_draw_indirect;
+    PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect;
+
+    // immutable storage, which can stay mapped while the GPU reads it
+    bool buffer_storage;
+    PFNGLBUFFERSTORAGEPROC BufferStorage;
+};
+
+extern GLExtensions gl_ext;
+
+// Must be called after gladLoadGL with the same loader
+void load_gl_extensions(GLADloadfunc load);
+bool has_gl_extension(const char* name);
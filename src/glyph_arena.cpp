@@ -0,0 +1,128 @@
+#include "glyph_arena.h"
+
+#include <algorithm>
+
+#include "glad.h"
+#include "glyph_cache.h"
+#include "memory_usage.h"
+
+GlyphArena::GlyphArena(): n_vertices(0), n_indices(0), vertex_capacity(0), index_capacity(0), live_vertices(0), live_indices(0) {
+    glGenBuffers(1, &vertex_buffer);
+    glGenBuffers(1, &index_buffer);
+}
+
+GlyphArena::~GlyphArena() {
+    memory_usage.releaseBuffer(vertex_buffer);
+    memory_usage.releaseBuffer(index_buffer);
+    glDeleteBuffers(1, &vertex_buffer);
+    glDeleteBuffers(1, &index_buffer);
+}
+
+// Grows the buffer geometrically, copying the existing contents on the GPU
+static void reserve(unsigned int& buffer, size_t& capacity, size_t used, size_t needed) {
+    if (used + needed <= capacity) return;
+
+    size_t new_capacity = std::max(used + needed, 2 * capacity);
+    unsigned int new_buffer;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_capacity, nullptr, GL_STATIC_DRAW);
+
+    if (used > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    memory_usage.releaseBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+    buffer = new_buffer;
+    capacity = new_capacity;
+}
+
+bool GlyphArena::takeSpan(std::vector<Span>& spans, size_t count, size_t& offset) {
+    auto best = spans.end();
+    for (auto it = spans.begin(); it != spans.end(); ++it) {
+        if (it->count >= count && (best == spans.end() || it->count < best->count)) {
+            best = it;
+        }
+    }
+    if (best == spans.end()) return false;
+
+    offset = best->offset;
+    best->offset += count;
+    best->count -= count;
+    if (best->count == 0) {
+        spans.erase(best);
+    }
+    return true;
+}
+
+void GlyphArena::releaseSpan(std::vector<Span>& spans, size_t& end, size_t offset, size_t count) {
+    auto next = std::lower_bound(spans.begin(), spans.end(), offset, [](const Span& span, size_t o) { return span.offset < o; });
+    if (next != spans.begin() && std::prev(next)->offset + std::prev(next)->count == offset) {
+        next = std::prev(next);
+        next->count += count;
+    } else {
+        next = spans.insert(next, Span{offset, count});
+    }
+    auto after = std::next(next);
+    if (after != spans.end() && next->offset + next->count == after->offset) {
+        next->count += after->count;
+        spans.erase(after);
+    }
+
+    // the last span is the only one that can reach the end
+    if (spans.back().offset + spans.back().count == end) {
+        end = spans.back().offset;
+        spans.pop_back();
+    }
+}
+
+void GlyphArena::append(const glm::vec2* vertices, size_t vertex_count, const unsigned int* indices, size_t index_count, GlyphGeometry& geometry) {
+    size_t vertex_offset, index_offset;
+    if (!takeSpan(free_vertices, vertex_count, vertex_offset)) {
+        reserve(vertex_buffer, vertex_capacity, n_vertices*sizeof(glm::vec2), vertex_count*sizeof(glm::vec2));
+        vertex_offset = n_vertices;
+        n_vertices += vertex_count;
+    }
+    if (!takeSpan(free_indices, index_count, index_offset)) {
+        reserve(index_buffer, index_capacity, n_indices*sizeof(unsigned int), index_count*sizeof(unsigned int));
+        index_offset = n_indices;
+        n_indices += index_count;
+    }
+
+    live_vertices += vertex_count;
+    live_indices += index_count;
+    account();
+
+    geometry.base_vertex = vertex_offset;
+    geometry.vertex_count = vertex_count;
+    geometry.index_offset = index_offset;
+    geometry.index_count = index_count;
+
+    // buffers are bound through the copy targets since the element array binding is VAO state
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertex_offset*sizeof(glm::vec2), vertex_count*sizeof(glm::vec2), vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, index_offset*sizeof(unsigned int), index_count*sizeof(unsigned int), indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GlyphArena::release(const GlyphGeometry& geometry) {
+    if (geometry.vertex_count > 0) {
+        releaseSpan(free_vertices, n_vertices, geometry.base_vertex, geometry.vertex_count);
+    }
+    if (geometry.index_count > 0) {
+        releaseSpan(free_indices, n_indices, geometry.index_offset, geometry.index_count);
+    }
+    live_vertices -= geometry.vertex_count;
+    live_indices -= geometry.index_count;
+    account();
+}
+
+void GlyphArena::account() const {
+    memory_usage.setBuffer(vertex_buffer, "glyph vertices", vertex_capacity, live_vertices*sizeof(glm::vec2));
+    memory_usage.setBuffer(index_buffer, "glyph indices", index_capacity, live_indices*sizeof(unsigned int));
+}
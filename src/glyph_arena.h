@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "glm/vec2.hpp"
+
+struct GlyphGeometry;
+
+// One vertex/index buffer pair holding the geometry of every glyph cache,
+// so that glyphs of different faces are drawn from the same buffers. The
+// buffers grow on the GPU when full, and the ranges released by evicted
+// geometry are reused before growing.
+class GlyphArena {
+public:
+    GlyphArena();
+    ~GlyphArena();
+
+    GlyphArena(const GlyphArena&) = delete;
+    GlyphArena& operator=(const GlyphArena&) = delete;
+
+    // Uploads the geometry and fills in its ranges
+    void append(const glm::vec2* vertices, size_t vertex_count, const unsigned int* indices, size_t index_count, GlyphGeometry& geometry);
+    void release(const GlyphGeometry& geometry);
+
+    unsigned int vbo() const { return vertex_buffer; }
+    unsigned int ebo() const { return index_buffer; }
+    size_t vertexCount() const { return n_vertices; }
+
+private:
+    struct Span {
+        size_t offset, count;
+    };
+
+    // Takes the smallest released span that fits, returns false if there is none
+    static bool takeSpan(std::vector<Span>& spans, size_t count, size_t& offset);
+    // Adds a span merged with its released neighbours, a span reaching end gives its room back to the end
+    static void releaseSpan(std::vector<Span>& spans, size_t& end, size_t offset, size_t count);
+    // Declares the buffers to the memory accounting, released spans not being in use
+    void account() const;
+
+    unsigned int vertex_buffer, index_buffer;
+    size_t n_vertices, n_indices;
+    size_t vertex_capacity, index_capacity;  // bytes
+    size_t live_vertices, live_indices;
+    // ranges released by evicted geometry, reused before growing the buffers,
+    // sorted by offset and never adjacent to each other
+    std::vector<Span> free_vertices, free_indices;
+};
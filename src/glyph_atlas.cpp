@@ -0,0 +1,177 @@
+#include "glyph_atlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "glad.h"
+#include "memory_usage.h"
+
+static const int padding = 1;
+
+static unsigned int pixel_format(int channels) {
+    return channels == 4 ? GL_BGRA : GL_RED;
+}
+
+GlyphAtlas::GlyphAtlas(int width, int height, int channels):
+    atlas_width(width), atlas_height(height), n_channels(channels), pixels(width*height*channels, 0), n_evictions(0), dirty(false) {
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, channels == 4 ? GL_RGBA8 : GL_R8, width, height, 0, pixel_format(channels), GL_UNSIGNED_BYTE, pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    memory_usage.setTexture(tex, channels == 4 ? "color atlas" : "glyph atlas", (size_t)width*height*channels);
+    memory_usage.addSource(this, MemoryCategory::Atlas, [this] { return cpuBytes(); });
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    memory_usage.removeSource(this);
+    memory_usage.releaseTexture(tex);
+    glDeleteTextures(1, &tex);
+}
+
+size_t GlyphAtlas::cpuBytes() const {
+    // one list node per entry on top of the map
+    return vector_bytes(pixels) + vector_bytes(shelves) + vector_bytes(free_slots) + map_bytes(entries) +
+           lru.size() * (sizeof(unsigned int) + 2 * sizeof(void*));
+}
+
+const AtlasEntry* GlyphAtlas::find(unsigned int glyph_index) {
+    auto it = entries.find(glyph_index);
+    if (it == entries.end()) return nullptr;
+
+    lru.splice(lru.begin(), lru, it->second.lru);
+    return &it->second;
+}
+
+const AtlasEntry* GlyphAtlas::insert(unsigned int glyph_index, const unsigned char* src, int w, int h, int pitch, int bearing_x, int bearing_y) {
+    int slot_w = w + 2*padding;
+    int slot_h = h + 2*padding;
+    if (slot_w > atlas_width || slot_h > atlas_height) return nullptr;
+
+    auto existing = entries.find(glyph_index);
+    if (existing != entries.end()) {
+        free_slots.push_back(existing->second.slot);
+        lru.erase(existing->second.lru);
+        entries.erase(existing);
+    }
+
+    AtlasRegion slot;
+    while (!allocate(slot_w, slot_h, slot)) {
+        if (lru.empty()) {
+            // only fragmented free slots are left, start over with an empty atlas
+            reset();
+            if (!allocate(slot_w, slot_h, slot)) return nullptr;
+            break;
+        }
+        evictLeastRecent();
+    }
+
+    AtlasEntry entry;
+    entry.slot = slot;
+    entry.region = AtlasRegion{slot.x + padding, slot.y + padding, w, h};
+    entry.bearing_x = bearing_x;
+    entry.bearing_y = bearing_y;
+
+    for (int row = slot.y; row < slot.y + slot.h; row++) {
+        std::memset(&pixels[(row*atlas_width + slot.x)*n_channels], 0, slot.w*n_channels);
+    }
+    for (int row = 0; row < h; row++) {
+        // FreeType uses a negative pitch for bottom-up bitmaps
+        const unsigned char* src_row = pitch >= 0 ? src + row*pitch : src + (h-1-row)*(-pitch);
+        std::memcpy(&pixels[((entry.region.y + row)*atlas_width + entry.region.x)*n_channels], src_row, w*n_channels);
+    }
+    markDirty(slot);
+
+    lru.push_front(glyph_index);
+    entry.lru = lru.begin();
+    return &(entries[glyph_index] = entry);
+}
+
+bool GlyphAtlas::allocate(int w, int h, AtlasRegion& slot) {
+    // reuse the smallest freed slot that fits
+    auto best = free_slots.end();
+    for (auto it = free_slots.begin(); it != free_slots.end(); ++it) {
+        if (it->w >= w && it->h >= h && (best == free_slots.end() || it->w*it->h < best->w*best->h)) {
+            best = it;
+        }
+    }
+    if (best != free_slots.end()) {
+        slot = *best;
+        free_slots.erase(best);
+        return true;
+    }
+
+    // then the shelf with the least wasted height
+    Shelf* best_shelf = nullptr;
+    for (Shelf& shelf : shelves) {
+        if (shelf.height >= h && shelf.cursor + w <= atlas_width && (!best_shelf || shelf.height < best_shelf->height)) {
+            best_shelf = &shelf;
+        }
+    }
+
+    if (!best_shelf) {
+        int y = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+        if (y + h > atlas_height) return false;
+        shelves.push_back(Shelf{y, h, 0});
+        best_shelf = &shelves.back();
+    }
+
+    slot = AtlasRegion{best_shelf->cursor, best_shelf->y, w, best_shelf->height};
+    best_shelf->cursor += w;
+    return true;
+}
+
+void GlyphAtlas::evictLeastRecent() {
+    unsigned int glyph_index = lru.back();
+    lru.pop_back();
+
+    auto it = entries.find(glyph_index);
+    free_slots.push_back(it->second.slot);
+    entries.erase(it);
+    n_evictions++;
+}
+
+void GlyphAtlas::reset() {
+    n_evictions += entries.size();
+    entries.clear();
+    lru.clear();
+    shelves.clear();
+    free_slots.clear();
+}
+
+void GlyphAtlas::markDirty(const AtlasRegion& r) {
+    if (!dirty) {
+        dirty_x0 = r.x;
+        dirty_y0 = r.y;
+        dirty_x1 = r.x + r.w;
+        dirty_y1 = r.y + r.h;
+        dirty = true;
+        return;
+    }
+    dirty_x0 = std::min(dirty_x0, r.x);
+    dirty_y0 = std::min(dirty_y0, r.y);
+    dirty_x1 = std::max(dirty_x1, r.x + r.w);
+    dirty_y1 = std::max(dirty_y1, r.y + r.h);
+}
+
+void GlyphAtlas::upload() {
+    if (!dirty) return;
+
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, atlas_width);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, dirty_x0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, dirty_y0);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, dirty_x0, dirty_y0, dirty_x1 - dirty_x0, dirty_y1 - dirty_y0, pixel_format(n_channels), GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    dirty = false;
+}
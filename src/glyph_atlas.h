@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+struct AtlasRegion {
+    int x, y, w, h;
+};
+
+struct AtlasEntry {
+    AtlasRegion region;
+    AtlasRegion slot;  // region plus padding, returned to the free list on eviction
+    int bearing_x, bearing_y;
+    std::list<unsigned int>::iterator lru;
+};
+
+// Shelf-packed texture holding rasterized glyphs, either single channel
+// coverage or four channel color in FreeType's premultiplied BGRA order.
+// Glyphs are inserted as they are first used; when the atlas is full the
+// least recently used glyphs are evicted and their slots are reused.
+class GlyphAtlas {
+public:
+    GlyphAtlas(int width, int height, int channels = 1);
+    ~GlyphAtlas();
+
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+    // Returns nullptr if the glyph is not resident, marks it as recently used otherwise
+    const AtlasEntry* find(unsigned int glyph_index);
+    // Copies a bitmap with the channels of the atlas, returns nullptr if it can never fit
+    const AtlasEntry* insert(unsigned int glyph_index, const unsigned char* pixels, int w, int h, int pitch, int bearing_x, int bearing_y);
+
+    // Uploads the region modified since the last call with glTexSubImage2D
+    void upload();
+    // Forgets every glyph, for when the face they were rasterized from changes
+    void clear() { reset(); }
+
+    unsigned int texture() const { return tex; }
+    int width() const { return atlas_width; }
+    int height() const { return atlas_height; }
+    int channels() const { return n_channels; }
+    unsigned int evictions() const { return n_evictions; }
+    // Heap bytes of the pixels and the packing state
+    size_t cpuBytes() const;
+
+private:
+    struct Shelf {
+        int y, height, cursor;
+    };
+
+    bool allocate(int w, int h, AtlasRegion& slot);
+    void evictLeastRecent();
+    void reset();
+    void markDirty(const AtlasRegion& r);
+
+    int atlas_width, atlas_height, n_channels;
+    unsigned int tex;
+    std::vector<unsigned char> pixels;
+
+    std::vector<Shelf> shelves;
+    std::vector<AtlasRegion> free_slots;
+    std::unordered_map<unsigned int, AtlasEntry> entries;
+    std::list<unsigned int> lru;  // most recently used first
+    unsigned int n_evictions;
+
+    bool dirty;
+    int dirty_x0, dirty_y0, dirty_x1, dirty_y1;
+};
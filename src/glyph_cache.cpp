@@ -0,0 +1,403 @@
+#include "glyph_cache.h"
+
+#include <algorithm>
+
+#include FT_MULTIPLE_MASTERS_H
+#include FT_SIZES_H
+#include "glyph_arena.h"
+#include "glyph_disk_cache.h"
+#include "glyph_lod.h"
+#include "memory_usage.h"
+#include "outline.h"
+
+size_t build_contour_strips(const OutlineState& st, std::vector<glm::vec2>& vertices, std::vector<unsigned int>& indices) {
+    size_t shared = 0;
+    for (const auto& line : st.lines) {
+        if (!indices.empty()) {
+            indices.push_back(restart_index);
+        }
+        // the decomposer closes contours on the exact start point
+        size_t n = line.size();
+        bool closed = n > 2 && line[n - 1] == line[0];
+        unsigned int first = vertices.size();
+        for (size_t i = 0; i < (closed ? n - 1 : n); i++) {
+            indices.push_back(vertices.size());
+            vertices.push_back(line[i]);
+        }
+        if (closed) {
+            indices.push_back(first);
+            shared++;
+        }
+    }
+    return shared;
+}
+
+const char* glyph_status_name(GlyphStatus status) {
+    switch (status) {
+    case GlyphStatus::Ok: return "ok";
+    case GlyphStatus::InvalidIndex: return "invalid index";
+    case GlyphStatus::LoadFailed: return "load failed";
+    case GlyphStatus::NotOutline: return "not an outline";
+    }
+    return "unknown";
+}
+
+float flattening_tolerance(float tolerance, bool simplify) {
+    return simplify ? 0.5f * tolerance : tolerance;
+}
+
+GlyphStatus flatten_glyph(FT_Face face, unsigned int glyph_index, float tolerance, bool simplify, FlattenedGlyph& glyph,
+                          unsigned int pixel_size) {
+    glyph.vertices.clear();
+    glyph.indices.clear();
+    glyph.advance = glyph.bearing_x = 0.f;
+    glyph.n_points = glyph.n_removed = glyph.n_shared = 0;
+
+    if (glyph_index >= (unsigned int)face->num_glyphs) return GlyphStatus::InvalidIndex;
+    FT_Int32 flags = pixel_size ? FT_LOAD_NO_BITMAP : FT_LOAD_NO_SCALE;
+    if (FT_Load_Glyph(face, glyph_index, flags)) return GlyphStatus::LoadFailed;
+
+    // hinted glyphs come in 26.6 pixels
+    float units = pixel_size ? (float)face->units_per_EM / (64.f * (float)pixel_size) : 1.f;
+    float height = (float)(face->ascender - face->descender) / units;
+    glyph.advance = (float)face->glyph->metrics.horiAdvance / height;
+    glyph.bearing_x = (float)face->glyph->metrics.horiBearingX / height;
+    if (face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) return GlyphStatus::NotOutline;
+
+    OutlineState st;
+    st.origin = glm::vec2(0, 0);
+    st.scale = height;
+    st.tolerance = flattening_tolerance(tolerance, simplify);
+    decompose_outline(&face->glyph->outline, st);
+
+    for (const auto& line : st.lines) {
+        glyph.n_points += line.size();
+    }
+    glyph.n_removed = simplify ? simplify_outline(st, tolerance - st.tolerance) : 0;
+
+    // simplification would have dropped the repeated curve starts anyway,
+    // only the closing vertices of the contours are saved then
+    glyph.n_shared = (simplify ? 0 : st.n_shared) + build_contour_strips(st, glyph.vertices, glyph.indices);
+    return GlyphStatus::Ok;
+}
+
+GlyphCache::GlyphCache(GlyphArena& arena, FT_Face face, GlyphDiskCache* disk_cache, LodWorker* lod_worker):
+    arena(arena), ft_face(face), disk_cache(disk_cache), lod_worker(lod_worker), hinted_size(nullptr), current_level(0),
+    simplify(false), n_flattened_points(0), n_removed_points(0), n_stored_vertices(0), n_shared_points(0) {
+    memory_usage.addSource(this, MemoryCategory::GlyphCache, [this] { return cpuBytes(); });
+}
+
+GlyphCache::~GlyphCache() {
+    memory_usage.removeSource(this);
+    if (hinted_size) FT_Done_Size(hinted_size);
+
+    // the arena outlives the caches sharing it
+    instances.push_front(std::move(current));
+    for (const Instance& instance : instances) {
+        releaseInstance(instance);
+    }
+}
+
+const GlyphGeometry* GlyphCache::find(unsigned int glyph_index) const {
+    if (current_level != 0) {
+        auto levels = current.lods.find(glyph_index);
+        if (levels != current.lods.end()) {
+            for (const LodGeometry& lod : levels->second) {
+                if (lod.level == current_level) return &lod.geometry;
+            }
+        }
+    }
+
+    auto it = current.glyphs.find(glyph_index);
+    return it == current.glyphs.end() ? nullptr : &it->second;
+}
+
+const GlyphGeometry& GlyphCache::get(unsigned int glyph_index) {
+    const GlyphGeometry* geometry;
+    load(glyph_index, geometry);
+    return *geometry;
+}
+
+size_t GlyphCache::failures(GlyphStatus status) const {
+    return std::count_if(failed.begin(), failed.end(), [status](const auto& glyph) { return glyph.second == status; });
+}
+
+GlyphStatus GlyphCache::load(unsigned int glyph_index, const GlyphGeometry*& result) {
+    auto failure = failed.find(glyph_index);
+    GlyphStatus status = failure == failed.end() ? GlyphStatus::Ok : failure->second;
+
+    auto cached = current.glyphs.find(glyph_index);
+    if (cached != current.glyphs.end()) {
+        result = &cached->second;
+        return status;
+    }
+
+    GlyphGeometry geometry{0, 0, 0, 0, 0.f, 0.f};
+    if (status != GlyphStatus::Ok) {
+        // failed in another instance, the metrics of this one are still loaded
+        FlattenedGlyph glyph;
+        flatten(glyph_index, glyph);
+        geometry.advance = glyph.advance;
+        geometry.bearing_x = glyph.bearing_x;
+        result = &(current.glyphs[glyph_index] = geometry);
+        return status;
+    }
+
+    // the LOD worker and the disk cache only know about the default instance
+    bool default_instance = defaultInstance();
+    if (lod_worker && default_instance && current_level != 0) {
+        lod_worker->request(glyph_index, current_level, simplify);
+    }
+
+    if (disk_cache && default_instance) {
+        if (const DiskGlyph* stored = disk_cache->find(glyph_index)) {
+            geometry.advance = stored->advance;
+            geometry.bearing_x = stored->bearing_x;
+            arena.append(stored->vertices(), stored->n_vertices, stored->indices(), stored->n_indices, geometry);
+            result = &(current.glyphs[glyph_index] = geometry);
+            return GlyphStatus::Ok;
+        }
+    }
+
+    FlattenedGlyph glyph;
+    status = flatten(glyph_index, glyph);
+    if (status != GlyphStatus::Ok) {
+        failed[glyph_index] = status;
+        geometry.advance = glyph.advance;
+        geometry.bearing_x = glyph.bearing_x;
+        result = &(current.glyphs[glyph_index] = geometry);
+        return status;
+    }
+    n_flattened_points += glyph.n_points;
+    n_removed_points += glyph.n_removed;
+    n_stored_vertices += glyph.vertices.size();
+    n_shared_points += glyph.n_shared;
+
+    geometry.advance = glyph.advance;
+    geometry.bearing_x = glyph.bearing_x;
+    arena.append(glyph.vertices.data(), glyph.vertices.size(), glyph.indices.data(), glyph.indices.size(), geometry);
+    if (disk_cache && default_instance) {
+        disk_cache->append(glyph_index, geometry.advance, geometry.bearing_x, glyph.vertices.data(), glyph.vertices.size(),
+                           glyph.indices.data(), glyph.indices.size());
+    }
+
+    result = &(current.glyphs[glyph_index] = geometry);
+    return GlyphStatus::Ok;
+}
+
+GlyphStatus GlyphCache::flatten(unsigned int glyph_index, FlattenedGlyph& glyph) {
+    if (current.pixel_size == 0) {
+        return flatten_glyph(ft_face, glyph_index, base_tolerance, simplify, glyph);
+    }
+
+    if (!hinted_size && FT_New_Size(ft_face, &hinted_size)) return GlyphStatus::LoadFailed;
+    FT_Size previous = ft_face->size;
+    FT_Activate_Size(hinted_size);
+    // setting the size runs the font program again, only do it when the size changes
+    GlyphStatus status = GlyphStatus::LoadFailed;
+    if (hinted_size->metrics.y_ppem == current.pixel_size || !FT_Set_Pixel_Sizes(ft_face, 0, current.pixel_size)) {
+        status = flatten_glyph(ft_face, glyph_index, base_tolerance, simplify, glyph, current.pixel_size);
+    }
+    FT_Activate_Size(previous);
+    return status;
+}
+
+void GlyphCache::setLevel(int level) {
+    if (level == current_level) return;
+    current_level = level;
+    requestLevel();
+}
+
+void GlyphCache::requestLevel() {
+    if (!lod_worker || !defaultInstance()) return;
+
+    // requests for the previous level are no longer useful
+    lod_worker->cancel();
+    if (current_level == 0) return;
+
+    int level = current_level;
+    for (const auto& glyph : current.glyphs) {
+        if (failed.count(glyph.first)) continue;
+        auto levels = current.lods.find(glyph.first);
+        bool resident = levels != current.lods.end() && std::any_of(levels->second.begin(), levels->second.end(),
+                                                                    [level](const LodGeometry& lod) { return lod.level == level; });
+        if (!resident) {
+            lod_worker->request(glyph.first, level, simplify);
+        }
+    }
+}
+
+void GlyphCache::update() {
+    std::vector<LodResult> results;
+    if (!lod_worker || !lod_worker->poll(results)) return;
+    // results finishing after a switch to another instance were flattened for the default one
+    if (!defaultInstance()) return;
+
+    for (const LodResult& result : results) {
+        n_flattened_points += result.n_points;
+        n_removed_points += result.n_removed;
+        n_stored_vertices += result.vertices.size();
+        n_shared_points += result.n_shared;
+        storeLevel(result.glyph_index, result.level, result.vertices, result.indices);
+    }
+}
+
+void GlyphCache::storeLevel(unsigned int glyph_index, int level, const std::vector<glm::vec2>& vertices, const std::vector<unsigned int>& indices) {
+    auto cached = current.glyphs.find(glyph_index);
+    if (cached == current.glyphs.end()) return;
+
+    std::vector<LodGeometry>& levels = current.lods[glyph_index];
+    for (const LodGeometry& lod : levels) {
+        if (lod.level == level) return;
+    }
+
+    if (levels.size() >= max_cached_levels) {
+        // evict the level furthest from the one being displayed
+        auto furthest = std::max_element(levels.begin(), levels.end(), [this](const LodGeometry& a, const LodGeometry& b) {
+            return std::abs(a.level - current_level) < std::abs(b.level - current_level);
+        });
+        arena.release(furthest->geometry);
+        levels.erase(furthest);
+    }
+
+    LodGeometry lod;
+    lod.level = level;
+    lod.geometry.advance = cached->second.advance;
+    lod.geometry.bearing_x = cached->second.bearing_x;
+    arena.append(vertices.data(), vertices.size(), indices.data(), indices.size(), lod.geometry);
+    levels.push_back(lod);
+}
+
+void GlyphCache::setInstance(const std::vector<FT_Fixed>& coords) {
+    if (coords == current.coords) return;
+
+    FT_Set_Var_Design_Coordinates(ft_face, coords.size(), const_cast<FT_Fixed*>(coords.data()));
+    switchInstance(coords, current.pixel_size);
+}
+
+void GlyphCache::setPixelSize(unsigned int pixel_size) {
+    if (pixel_size == current.pixel_size) return;
+    switchInstance(current.coords, pixel_size);
+}
+
+void GlyphCache::switchInstance(const std::vector<FT_Fixed>& coords, unsigned int pixel_size) {
+    if (lod_worker) {
+        lod_worker->cancel();
+    }
+
+    instances.push_front(std::move(current));
+    auto cached = std::find_if(std::next(instances.begin()), instances.end(), [&coords, pixel_size](const Instance& instance) {
+        return instance.coords == coords && instance.pixel_size == pixel_size;
+    });
+    if (cached != instances.end()) {
+        current = std::move(*cached);
+        instances.erase(cached);
+    } else {
+        current = Instance();
+        current.coords = coords;
+        current.pixel_size = pixel_size;
+    }
+    evictInstances();
+    requestLevel();
+}
+
+bool GlyphCache::hasInstance(const std::vector<FT_Fixed>& coords) const {
+    unsigned int pixel_size = current.pixel_size;
+    if (coords == current.coords) return true;
+    return std::any_of(instances.begin(), instances.end(), [&coords, pixel_size](const Instance& instance) {
+        return instance.coords == coords && instance.pixel_size == pixel_size;
+    });
+}
+
+void GlyphCache::store(const std::vector<FT_Fixed>& coords, unsigned int glyph_index, const FlattenedGlyph& glyph) {
+    // glyphs flattened elsewhere are unhinted
+    Instance* instance = &current;
+    if (coords != current.coords || current.pixel_size != 0) {
+        auto cached = std::find_if(instances.begin(), instances.end(), [&coords](const Instance& instance) {
+            return instance.coords == coords && instance.pixel_size == 0;
+        });
+        if (cached == instances.end()) {
+            instances.push_front(Instance());
+            instances.front().coords = coords;
+            cached = instances.begin();
+        }
+        instance = &*cached;
+    }
+    if (instance->glyphs.count(glyph_index)) return;
+
+    n_flattened_points += glyph.n_points;
+    n_removed_points += glyph.n_removed;
+    n_stored_vertices += glyph.vertices.size();
+    n_shared_points += glyph.n_shared;
+
+    GlyphGeometry geometry;
+    geometry.advance = glyph.advance;
+    geometry.bearing_x = glyph.bearing_x;
+    arena.append(glyph.vertices.data(), glyph.vertices.size(), glyph.indices.data(), glyph.indices.size(), geometry);
+    instance->glyphs[glyph_index] = geometry;
+
+    evictInstances();
+}
+
+std::vector<unsigned int> GlyphCache::glyphIndices() const {
+    std::vector<unsigned int> indices;
+    for (const auto& glyph : current.glyphs) {
+        indices.push_back(glyph.first);
+    }
+    return indices;
+}
+
+void GlyphCache::evictInstances() {
+    while (instances.size() > max_cached_instances) {
+        releaseInstance(instances.back());
+        instances.pop_back();
+    }
+}
+
+bool GlyphCache::trim() {
+    bool released = !instances.empty();
+    for (const Instance& instance : instances) {
+        releaseInstance(instance);
+    }
+    instances.clear();
+
+    for (auto& levels : current.lods) {
+        auto displayed = std::partition(levels.second.begin(), levels.second.end(), [this](const LodGeometry& lod) {
+            return lod.level == current_level;
+        });
+        for (auto it = displayed; it != levels.second.end(); ++it) {
+            arena.release(it->geometry);
+            released = true;
+        }
+        levels.second.erase(displayed, levels.second.end());
+    }
+    return released;
+}
+
+size_t GlyphCache::cpuBytes() const {
+    size_t bytes = map_bytes(failed);
+    auto instance_bytes = [](const Instance& instance) {
+        size_t bytes = vector_bytes(instance.coords) + map_bytes(instance.glyphs) + map_bytes(instance.lods);
+        for (const auto& levels : instance.lods) {
+            bytes += vector_bytes(levels.second);
+        }
+        return bytes;
+    };
+    bytes += instance_bytes(current);
+    for (const Instance& instance : instances) {
+        // list node besides the instance
+        bytes += sizeof(Instance) + 2 * sizeof(void*) + instance_bytes(instance);
+    }
+    return bytes;
+}
+
+void GlyphCache::releaseInstance(const Instance& instance) {
+    for (const auto& glyph : instance.glyphs) {
+        arena.release(glyph.second);
+    }
+    for (const auto& levels : instance.lods) {
+        for (const LodGeometry& lod : levels.second) {
+            arena.release(lod.geometry);
+        }
+    }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include "glm/vec2.hpp"
+
+class GlyphArena;
+class GlyphDiskCache;
+class LodWorker;
+struct OutlineState;
+
+// Index used to separate the contours of a glyph inside one GL_LINE_STRIP draw
+static const unsigned int restart_index = 0xFFFFFFFF;
+
+struct GlyphGeometry {
+    // indices are local to the glyph and offset by base_vertex when drawn
+    unsigned int base_vertex, vertex_count;
+    unsigned int index_offset, index_count;
+    float advance, bearing_x;
+};
+
+struct GlyphInstance {
+    unsigned int glyph_index;
+    glm::vec2 offset;
+};
+
+// Concatenates the contours into one vertex list with local indices separated by restart_index.
+// Closed contours end on the index of their first vertex instead of a copy of it, the
+// number of vertices shared this way is returned.
+size_t build_contour_strips(const OutlineState& st, std::vector<glm::vec2>& vertices, std::vector<unsigned int>& indices);
+
+// Outcome of loading a glyph, the glyphs that fail are skipped rather than fatal
+enum class GlyphStatus {
+    Ok,
+    InvalidIndex,  // past the glyphs of the face
+    LoadFailed,    // FreeType error, usually a corrupt font
+    NotOutline,    // bitmap, color or SVG only glyph
+};
+
+const char* glyph_status_name(GlyphStatus status);
+
+struct FlattenedGlyph {
+    std::vector<glm::vec2> vertices;
+    std::vector<unsigned int> indices;
+    float advance, bearing_x;
+    size_t n_points, n_removed;  // points before simplification and points it removed
+    size_t n_shared;             // segment ends stored once for the two segments they join
+};
+
+// Part of the tolerance of a glyph left to flattening, the rest going to
+// simplification so that their errors add up to at most the tolerance
+float flattening_tolerance(float tolerance, bool simplify);
+
+// Loads the glyph unscaled from face and flattens it, normalized by the face height.
+// With a pixel size, the glyph is loaded hinted at the active size of the face
+// instead, which must have been set to that size, and scaled back to font units.
+// The advance and bearing are still filled in for glyphs that are not outlines.
+// The contours stay within tolerance of the outline, simplification included.
+GlyphStatus flatten_glyph(FT_Face face, unsigned int glyph_index, float tolerance, bool simplify, FlattenedGlyph& glyph,
+                          unsigned int pixel_size = 0);
+
+// Flattened outlines of every glyph of one face used so far, uploaded into
+// an arena that may be shared with the caches of other faces. Coordinates are relative to the glyph origin on
+// the baseline and normalized by the ascender - descender height, so that
+// glyphs can be placed with a single per-instance offset.
+//
+// Besides the base geometry, a few other levels of detail are kept per
+// glyph. They are flattened by the LodWorker and drawn in place of the base
+// geometry once they are ready.
+//
+// For variable fonts the geometry of the recently used instances stays in
+// the buffers, so that going back to one of them does not flatten anything.
+// Hinted outlines are cached the same way, one instance per pixel size.
+// The disk cache and the LodWorker only serve the default unhinted instance.
+class GlyphCache {
+public:
+    // Glyphs found in the disk cache are uploaded from it without involving FreeType
+    GlyphCache(GlyphArena& arena, FT_Face face, GlyphDiskCache* disk_cache = nullptr, LodWorker* lod_worker = nullptr);
+    ~GlyphCache();
+
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    // Loads and uploads the base geometry of the glyph on first use. Glyphs
+    // that fail get empty geometry, so that they draw nothing, and are not
+    // loaded again.
+    GlyphStatus load(unsigned int glyph_index, const GlyphGeometry*& geometry);
+    // Same as load when the status does not matter
+    const GlyphGeometry& get(unsigned int glyph_index);
+    // Number of glyphs that failed to load with the given status
+    size_t failures(GlyphStatus status) const;
+    // Geometry to draw at the current level of detail, falling back to the base geometry
+    const GlyphGeometry* find(unsigned int glyph_index) const;
+
+    // Simplifies contours before they are uploaded, within the same tolerance as
+    // unsimplified contours, must match the setting the disk cache was opened with
+    void setSimplify(bool enabled) { simplify = enabled; }
+    // Points dropped by simplification out of the points flattened in this session
+    size_t removedPoints() const { return n_removed_points; }
+    size_t flattenedPoints() const { return n_flattened_points; }
+    // vertices uploaded for flattened glyphs, and the segment ends they do not repeat
+    size_t storedVertices() const { return n_stored_vertices; }
+    size_t sharedPoints() const { return n_shared_points; }
+
+    // Switches to the instance at the given design coordinates (16.16, empty
+    // for the default instance), also applying them to the face
+    void setInstance(const std::vector<FT_Fixed>& coords);
+    const std::vector<FT_Fixed>& instance() const { return current.coords; }
+    bool hasInstance(const std::vector<FT_Fixed>& coords) const;
+    // Switches to outlines hinted at the given pixels per em, 0 for the unhinted design outlines
+    void setPixelSize(unsigned int pixel_size);
+    unsigned int pixelSize() const { return current.pixel_size; }
+    // Adds a glyph flattened elsewhere to an instance, caching the instance if needed
+    void store(const std::vector<FT_Fixed>& coords, unsigned int glyph_index, const FlattenedGlyph& glyph);
+    // Glyphs loaded for the current instance
+    std::vector<unsigned int> glyphIndices() const;
+
+    // Requests every cached glyph at the new level from the worker
+    void setLevel(int level);
+    int level() const { return current_level; }
+    // Uploads the levels finished by the worker since the last call
+    void update();
+
+    // Releases the cached instances and the levels of detail other than the
+    // current one, for when memory is over budget. Returns false if there was nothing to release.
+    bool trim();
+    // Heap bytes of the maps of every instance
+    size_t cpuBytes() const;
+
+    FT_Face face() const { return ft_face; }
+    float height() const { return (float)(ft_face->ascender - ft_face->descender); }
+
+    const GlyphArena& geometryArena() const { return arena; }
+    size_t glyphCount() const { return current.glyphs.size(); }
+
+private:
+    struct LodGeometry {
+        int level;
+        GlyphGeometry geometry;
+    };
+
+    struct Instance {
+        std::vector<FT_Fixed> coords;
+        unsigned int pixel_size = 0;
+        std::unordered_map<unsigned int, GlyphGeometry> glyphs;
+        std::unordered_map<unsigned int, std::vector<LodGeometry>> lods;
+    };
+
+    // Moves the current instance to the cached ones and makes the one for coords and pixel_size current
+    void switchInstance(const std::vector<FT_Fixed>& coords, unsigned int pixel_size);
+    bool defaultInstance() const { return current.coords.empty() && current.pixel_size == 0; }
+    GlyphStatus flatten(unsigned int glyph_index, FlattenedGlyph& glyph);
+    void storeLevel(unsigned int glyph_index, int level, const std::vector<glm::vec2>& vertices, const std::vector<unsigned int>& indices);
+    // Queues the glyphs missing at the current level, for the default instance only
+    void requestLevel();
+    void evictInstances();
+    void releaseInstance(const Instance& instance);
+
+    // Levels of detail other than the base one kept per glyph
+    static const size_t max_cached_levels = 3;
+    // Instances kept besides the current one
+    static const size_t max_cached_instances = 8;
+
+    GlyphArena& arena;
+    FT_Face ft_face;
+    GlyphDiskCache* disk_cache;
+    LodWorker* lod_worker;
+    // hinted glyphs are loaded at this size rather than the one of the face, which the raster backdrop uses
+    FT_Size hinted_size;
+    Instance current;
+    std::list<Instance> instances;  // most recently used first
+    // glyphs that failed, whatever the instance
+    std::unordered_map<unsigned int, GlyphStatus> failed;
+    int current_level;
+    bool simplify;
+    size_t n_flattened_points, n_removed_points;
+    size_t n_stored_vertices, n_shared_points;
+};
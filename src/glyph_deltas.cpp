@@ -0,0 +1,149 @@
+#include "glyph_deltas.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include FT_MULTIPLE_MASTERS_H
+#include "glm/geometric.hpp"
+#include "glyph_cache.h"
+#include "glyph_lod.h"
+#include "outline.h"
+
+static FT_Fixed to_fixed(float value) {
+    return (FT_Fixed)std::lround(value * 65536.f);
+}
+
+static std::vector<FT_Fixed> default_design(const std::vector<VariationAxis>& axes) {
+    std::vector<FT_Fixed> design;
+    for (const VariationAxis& axis : axes) {
+        design.push_back(to_fixed(axis.default_value));
+    }
+    return design;
+}
+
+// Flattens the glyph at the current coordinates of the face, following and extending segment_counts
+static bool flatten_instance(FT_Face face, unsigned int glyph_index, std::vector<unsigned int>& segment_counts,
+                             std::vector<glm::vec2>& vertices, std::vector<unsigned int>& indices) {
+    if (FT_Load_Glyph(face, glyph_index, FT_LOAD_NO_SCALE) || face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
+        return false;
+    }
+
+    OutlineState st;
+    st.origin = glm::vec2(0, 0);
+    st.scale = (float)(face->ascender - face->descender);
+    st.tolerance = base_tolerance;
+    st.segment_counts = &segment_counts;
+    decompose_outline(&face->glyph->outline, st);
+
+    vertices.clear();
+    indices.clear();
+    build_contour_strips(st, vertices, indices);
+    return true;
+}
+
+static bool extract(FT_Face face, unsigned int glyph_index, const std::vector<VariationAxis>& axes, DeltaGlyph& glyph) {
+    std::vector<FT_Fixed> design = default_design(axes);
+    FT_Set_Var_Design_Coordinates(face, design.size(), design.data());
+
+    glyph.segment_counts.clear();
+    if (!flatten_instance(face, glyph_index, glyph.segment_counts, glyph.vertices, glyph.indices)) return false;
+    float height = (float)(face->ascender - face->descender);
+    glyph.advance = (float)face->glyph->metrics.horiAdvance / height;
+    glyph.bearing_x = (float)face->glyph->metrics.horiBearingX / height;
+
+    size_t n_curves = glyph.segment_counts.size();
+    glyph.deltas.assign(glyph.vertices.size() * max_delta_axes, glm::vec4(0, 0, 0, 0));
+
+    std::vector<glm::vec2> vertices;
+    std::vector<unsigned int> indices;
+    for (size_t a = 0; a < std::min(axes.size(), max_delta_axes); a++) {
+        for (int side = 0; side < 2; side++) {
+            design = default_design(axes);
+            design[a] = to_fixed(side == 0 ? axes[a].minimum : axes[a].maximum);
+            FT_Set_Var_Design_Coordinates(face, design.size(), design.data());
+
+            if (!flatten_instance(face, glyph_index, glyph.segment_counts, vertices, indices)) return false;
+            if (glyph.segment_counts.size() != n_curves || indices != glyph.indices) return false;
+
+            for (size_t v = 0; v < vertices.size(); v++) {
+                glm::vec2 d = vertices[v] - glyph.vertices[v];
+                glm::vec4& delta = glyph.deltas[v * max_delta_axes + a];
+                if (side == 0) {
+                    delta.x = d.x;
+                    delta.y = d.y;
+                } else {
+                    delta.z = d.x;
+                    delta.w = d.y;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool extract_glyph_deltas(FT_Face face, unsigned int glyph_index, const std::vector<VariationAxis>& axes, DeltaGlyph& glyph) {
+    std::vector<FT_Fixed> previous(axes.size());
+    FT_Get_Var_Design_Coordinates(face, previous.size(), previous.data());
+
+    bool ok = extract(face, glyph_index, axes, glyph);
+
+    FT_Set_Var_Design_Coordinates(face, previous.size(), previous.data());
+    return ok;
+}
+
+void interpolate_deltas(const DeltaGlyph& glyph, const std::vector<float>& normalized, std::vector<glm::vec2>& vertices) {
+    vertices = glyph.vertices;
+    for (size_t a = 0; a < std::min(normalized.size(), max_delta_axes); a++) {
+        float c = normalized[a];
+        for (size_t v = 0; v < vertices.size(); v++) {
+            const glm::vec4& delta = glyph.deltas[v * max_delta_axes + a];
+            vertices[v] += c < 0.f ? -c * glm::vec2(delta.x, delta.y) : c * glm::vec2(delta.z, delta.w);
+        }
+    }
+}
+
+float measure_delta_error(FT_Face face, unsigned int glyph_index, const std::vector<VariationAxis>& axes, const DeltaGlyph& glyph,
+                          size_t& n_samples) {
+    std::vector<std::vector<FT_Fixed>> samples;
+    for (size_t a = 0; a < axes.size(); a++) {
+        const VariationAxis& axis = axes[a];
+        for (float value : {axis.minimum, (axis.minimum + axis.default_value) / 2, (axis.default_value + axis.maximum) / 2, axis.maximum}) {
+            std::vector<FT_Fixed> design = default_design(axes);
+            design[a] = to_fixed(value);
+            samples.push_back(design);
+        }
+    }
+    if (axes.size() > 1) {
+        std::vector<FT_Fixed> minimum, maximum;
+        for (const VariationAxis& axis : axes) {
+            minimum.push_back(to_fixed(axis.minimum));
+            maximum.push_back(to_fixed(axis.maximum));
+        }
+        samples.push_back(minimum);
+        samples.push_back(maximum);
+    }
+
+    std::vector<FT_Fixed> previous(axes.size());
+    FT_Get_Var_Design_Coordinates(face, previous.size(), previous.data());
+
+    float max_error = 0.f;
+    n_samples = 0;
+    std::vector<unsigned int> segment_counts = glyph.segment_counts;
+    std::vector<glm::vec2> expected, interpolated;
+    std::vector<unsigned int> indices;
+    for (const std::vector<FT_Fixed>& design : samples) {
+        std::vector<float> normalized = normalized_coords(face, design);
+        FT_Set_Var_Design_Coordinates(face, design.size(), const_cast<FT_Fixed*>(design.data()));
+        if (!flatten_instance(face, glyph_index, segment_counts, expected, indices)) continue;
+        if (expected.size() != glyph.vertices.size()) continue;
+
+        interpolate_deltas(glyph, normalized, interpolated);
+        for (size_t v = 0; v < expected.size(); v++) {
+            max_error = std::max(max_error, glm::length(expected[v] - interpolated[v]));
+        }
+        n_samples++;
+    }
+
+    FT_Set_Var_Design_Coordinates(face, previous.size(), previous.data());
+    return max_error;
+}
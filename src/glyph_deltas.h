@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include "variations.h"
+
+// Axes interpolated by the vertex shader, the others stay at their default
+static const size_t max_delta_axes = 4;
+
+// Flattened outline of the default instance of a variable glyph with, for
+// every vertex and axis, its displacement at the minimum and at the maximum
+// of the axis (xy towards -1, zw towards +1 in normalized coordinates).
+// Every instance is flattened with the segment counts of the default one so
+// that vertices match, and the glyph at normalized coordinates c is then
+// position + sum |c_i| * delta_i on the side of c_i. This is exact for fonts
+// whose variations only peak at the ends of single axes, the error of the
+// others is measured by measure_delta_error.
+struct DeltaGlyph {
+    std::vector<glm::vec2> vertices;
+    std::vector<glm::vec4> deltas;  // max_delta_axes per vertex
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> segment_counts;
+    float advance, bearing_x;
+};
+
+// Returns false if the glyph is not an outline or changes topology between instances.
+// The coordinates of the face are left as they were.
+bool extract_glyph_deltas(FT_Face face, unsigned int glyph_index, const std::vector<VariationAxis>& axes, DeltaGlyph& glyph);
+
+// Same interpolation as the vertex shader
+void interpolate_deltas(const DeltaGlyph& glyph, const std::vector<float>& normalized, std::vector<glm::vec2>& vertices);
+
+// Largest distance between the interpolated vertices and the ones FreeType
+// gives at a few sample instances: each axis at its ends and halfway to
+// them, and every axis at its minimum and then at its maximum together.
+// In the normalized units of the vertices.
+float measure_delta_error(FT_Face face, unsigned int glyph_index, const std::vector<VariationAxis>& axes, const DeltaGlyph& glyph,
+                          size_t& n_samples);
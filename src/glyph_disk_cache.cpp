@@ -0,0 +1,126 @@
+#include "glyph_disk_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "cache_dir.h"
+#include "glyph_cache.h"
+
+static const char cache_magic[4] = {'F', 'V', 'G', 'C'};
+static const uint32_t cache_version = 2;
+
+GlyphDiskCache::GlyphDiskCache(): fd(-1), valid_size(0) {}
+
+GlyphDiskCache::~GlyphDiskCache() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool GlyphDiskCache::open(const MappedFile& font, unsigned int face_index, float flattening, float simplification) {
+    std::string dir = cache_directory();
+    if (dir.empty()) return false;
+
+    Header expected;
+    std::memcpy(expected.magic, cache_magic, sizeof(cache_magic));
+    expected.version = cache_version;
+    expected.font_hash = hash_bytes(font.data(), font.size());
+    expected.face_index = face_index;
+    expected.flattening = flattening;
+    expected.simplification = simplification;
+    expected.reserved = 0;
+
+    char name[96];
+    std::snprintf(name, sizeof(name), "/%016llx-%u-%g-%g.glyphs", (unsigned long long)expected.font_hash, face_index, flattening, simplification);
+    path = dir + name;
+
+    bool valid = load(expected);
+
+    fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open the glyph cache " << path << std::endl;
+        return false;
+    }
+
+    if (valid && valid_size < file.size()) {
+        // a record cut short by an interrupted append would corrupt the next ones
+        if (ftruncate(fd, valid_size) < 0) valid = false;
+    }
+
+    if (!valid) {
+        records.clear();
+        file.close();
+        if (ftruncate(fd, 0) < 0 || write(fd, &expected, sizeof(expected)) != sizeof(expected)) {
+            std::cerr << "Failed to initialize the glyph cache " << path << std::endl;
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Indices are local to the glyph, the arena and the pick index trust them to be in range
+static bool valid_indices(const DiskGlyph* glyph) {
+    const uint32_t* indices = glyph->indices();
+    for (uint32_t i = 0; i < glyph->n_indices; i++) {
+        if (indices[i] >= glyph->n_vertices && indices[i] != restart_index) return false;
+    }
+    return true;
+}
+
+bool GlyphDiskCache::load(const Header& expected) {
+    if (!file.open(path.c_str()) || file.size() < sizeof(Header)) return false;
+
+    const Header* header = reinterpret_cast<const Header*>(file.data());
+    if (std::memcmp(header, &expected, sizeof(Header)) != 0) return false;
+
+    size_t offset = sizeof(Header);
+    while (offset + sizeof(DiskGlyph) <= file.size()) {
+        const DiskGlyph* glyph = reinterpret_cast<const DiskGlyph*>(file.data() + offset);
+        uint64_t length = sizeof(DiskGlyph) + (uint64_t)glyph->n_vertices*sizeof(glm::vec2) + (uint64_t)glyph->n_indices*sizeof(uint32_t);
+        if (offset + length > file.size() || !valid_indices(glyph)) break;
+
+        records[glyph->glyph_index] = glyph;
+        offset += length;
+    }
+    valid_size = offset;
+
+    return true;
+}
+
+const DiskGlyph* GlyphDiskCache::find(unsigned int glyph_index) const {
+    auto it = records.find(glyph_index);
+    return it == records.end() ? nullptr : it->second;
+}
+
+void GlyphDiskCache::append(unsigned int glyph_index, float advance, float bearing_x,
+                            const glm::vec2* vertices, uint32_t n_vertices, const uint32_t* indices, uint32_t n_indices) {
+    if (fd < 0) return;
+
+    DiskGlyph record;
+    record.glyph_index = glyph_index;
+    record.n_vertices = n_vertices;
+    record.n_indices = n_indices;
+    record.advance = advance;
+    record.bearing_x = bearing_x;
+    record.reserved = 0;
+
+    // one write per record so that concurrent appends do not interleave
+    iovec parts[3] = {
+        {&record, sizeof(record)},
+        {const_cast<glm::vec2*>(vertices), n_vertices*sizeof(glm::vec2)},
+        {const_cast<uint32_t*>(indices), n_indices*sizeof(uint32_t)},
+    };
+    ssize_t expected = sizeof(record) + n_vertices*sizeof(glm::vec2) + n_indices*sizeof(uint32_t);
+    if (writev(fd, parts, 3) != expected) {
+        std::cerr << "Failed to append to the glyph cache " << path << std::endl;
+        ::close(fd);
+        fd = -1;
+    }
+}
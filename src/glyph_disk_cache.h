@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "glm/vec2.hpp"
+#include "mapped_file.h"
+
+// Record of one flattened glyph, followed in the file by its vertices and
+// its contour indices (local to the glyph, separated by restart_index)
+struct DiskGlyph {
+    uint32_t glyph_index;
+    uint32_t n_vertices, n_indices;
+    float advance, bearing_x;
+    uint32_t reserved;
+
+    const glm::vec2* vertices() const { return reinterpret_cast<const glm::vec2*>(this + 1); }
+    const uint32_t* indices() const { return reinterpret_cast<const uint32_t*>(vertices() + n_vertices); }
+};
+
+// Append-only file of flattened glyph geometry for one combination of font
+// file, face index, flattening and simplification. The file is memory-mapped
+// when opened and records are served straight from the mapping; glyphs
+// flattened during the session are appended for the next run.
+class GlyphDiskCache {
+public:
+    GlyphDiskCache();
+    ~GlyphDiskCache();
+
+    GlyphDiskCache(const GlyphDiskCache&) = delete;
+    GlyphDiskCache& operator=(const GlyphDiskCache&) = delete;
+
+    // Opens or creates the cache file in the cache directory, returns false if caching is unavailable
+    bool open(const MappedFile& font, unsigned int face_index, float flattening, float simplification);
+
+    const DiskGlyph* find(unsigned int glyph_index) const;
+    void append(unsigned int glyph_index, float advance, float bearing_x,
+                const glm::vec2* vertices, uint32_t n_vertices, const uint32_t* indices, uint32_t n_indices);
+
+    size_t glyphCount() const { return records.size(); }
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t font_hash;
+        uint32_t face_index;
+        float flattening;
+        float simplification;  // 0 when contours are not simplified
+        uint32_t reserved;
+    };
+
+    bool load(const Header& expected);
+
+    std::string path;
+    MappedFile file;
+    int fd;
+    size_t valid_size;
+    std::unordered_map<unsigned int, const DiskGlyph*> records;
+};
@@ -0,0 +1,92 @@
+#include "glyph_lod.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glyph_cache.h"
+#include "mapped_file.h"
+
+float lod_tolerance(int level) {
+    return std::ldexp(base_tolerance, -level);
+}
+
+int lod_level_for(float tolerance) {
+    int level = (int)std::ceil(std::log2(base_tolerance / tolerance));
+    return std::clamp(level, min_lod_level, max_lod_level);
+}
+
+LodWorker::LodWorker(): ft_lib(nullptr), face(nullptr), done(false) {}
+
+LodWorker::~LodWorker() {
+    if (thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+    if (face) FT_Done_Face(face);
+    if (ft_lib) FT_Done_FreeType(ft_lib);
+}
+
+bool LodWorker::open(const MappedFile& font, unsigned int face_index) {
+    if (FT_Init_FreeType(&ft_lib)) return false;
+    if (FT_New_Memory_Face(ft_lib, reinterpret_cast<const FT_Byte*>(font.data()), font.size(), face_index, &face)) return false;
+
+    thread = std::thread(&LodWorker::run, this);
+    return true;
+}
+
+void LodWorker::request(unsigned int glyph_index, int level, bool simplify) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(Request{glyph_index, level, simplify});
+    }
+    wake.notify_one();
+}
+
+void LodWorker::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    requests.clear();
+}
+
+bool LodWorker::poll(std::vector<LodResult>& results) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (finished.empty()) return false;
+
+    results = std::move(finished);
+    finished.clear();
+    return true;
+}
+
+void LodWorker::run() {
+    FlattenedGlyph glyph;
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return done || !requests.empty(); });
+            if (done) return;
+            request = requests.front();
+            requests.pop_front();
+        }
+
+        // glyphs whose base geometry failed are not requested, so errors are not expected
+        if (flatten_glyph(face, request.glyph_index, lod_tolerance(request.level), request.simplify, glyph) != GlyphStatus::Ok) {
+            continue;
+        }
+
+        LodResult result;
+        result.glyph_index = request.glyph_index;
+        result.level = request.level;
+        result.vertices = std::move(glyph.vertices);
+        result.indices = std::move(glyph.indices);
+        result.n_points = glyph.n_points;
+        result.n_removed = glyph.n_removed;
+        result.n_shared = glyph.n_shared;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.push_back(std::move(result));
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include "glm/vec2.hpp"
+
+class MappedFile;
+
+// Flattening tolerance of the base geometry, in normalized glyph units
+static const float base_tolerance = 1.f / 2048.f;
+// Level l is flattened with base_tolerance / 2^l, level 0 being the base geometry
+static const int min_lod_level = -6;
+static const int max_lod_level = 4;
+
+float lod_tolerance(int level);
+// Coarsest level whose tolerance is at most the given one
+int lod_level_for(float tolerance);
+
+struct LodResult {
+    unsigned int glyph_index;
+    int level;
+    std::vector<glm::vec2> vertices;
+    std::vector<unsigned int> indices;
+    size_t n_points;   // before simplification
+    size_t n_removed;  // points dropped by simplification
+    size_t n_shared;   // segment ends not repeated
+};
+
+// Re-flattens glyphs at other levels of detail on a background thread.
+// FreeType faces cannot be used from two threads, so the worker opens
+// its own face, with its own library, on the mapping of the font file.
+class LodWorker {
+public:
+    LodWorker();
+    ~LodWorker();
+
+    LodWorker(const LodWorker&) = delete;
+    LodWorker& operator=(const LodWorker&) = delete;
+
+    // Returns false if the font cannot be opened, the file must stay mapped while the worker runs
+    bool open(const MappedFile& font, unsigned int face_index);
+
+    // Contours are simplified if simplify is set, staying within the tolerance of the level
+    void request(unsigned int glyph_index, int level, bool simplify);
+    // Drops the requests that have not been started yet
+    void cancel();
+    // Moves the finished results into results, returns false if there are none
+    bool poll(std::vector<LodResult>& results);
+
+private:
+    struct Request {
+        unsigned int glyph_index;
+        int level;
+        bool simplify;
+    };
+
+    void run();
+
+    FT_Library ft_lib;
+    FT_Face face;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Request> requests;
+    std::vector<LodResult> finished;
+    bool done;
+    std::thread thread;
+};
@@ -0,0 +1,876 @@
+#include "line_renderer.h"
+
+#include <algorithm>
+#include <string>
+
+#include "gl_extensions.h"
+#include "glad.h"
+#include "glyph_arena.h"
+#include "glyph_atlas.h"
+#include "glyph_cache.h"
+#include "glyph_deltas.h"
+#include "memory_usage.h"
+#include "outline.h"
+#include "program_cache.h"
+
+static const float on_curve_marker_size = 7.f;   // pixels
+static const float off_curve_marker_size = 6.f;
+// initial size of each section of the stream ring, which grows for larger frames
+static const size_t stream_section_size = 256 * 1024;
+
+// commands are drawn layer by layer, whatever their state
+static const int backdrop_layer = 0;
+static const int glyph_layer = 1;
+static const int overlay_layer = 2;
+
+static const char* vertex_src = R"raw(#version 330 core
+layout(location = 0) in vec2 position;
+
+void main() {
+    gl_Position = vec4(2.0 * position - vec2(1.), 0.0, 1.0);
+})raw";
+
+static const char* fragment_src = R"raw(#version 330 core
+out vec4 color;
+
+void main() {
+    color = vec4(0.0, 0.0, 0.0, 1.0);
+})raw";
+
+static const char* instanced_vertex_src = R"raw(#version 330 core
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 instance_offset;
+
+uniform vec2 view_scale;
+uniform vec2 view_offset;
+
+void main() {
+    vec2 p = (position + instance_offset) * view_scale + view_offset;
+    gl_Position = vec4(2.0 * p - vec2(1.), 0.0, 1.0);
+})raw";
+
+// deltas[i] holds the displacement at the minimum of axis i in xy and at its maximum in zw
+static const char* delta_vertex_src = R"raw(#version 330 core
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec4 deltas[4];
+
+uniform vec2 view_scale;
+uniform vec2 view_offset;
+uniform vec2 glyph_offset;
+uniform vec4 axis_coords;
+
+void main() {
+    vec2 q = position;
+    for (int i = 0; i < 4; i++) {
+        float c = axis_coords[i];
+        q += c < 0.0 ? -c * deltas[i].xy : c * deltas[i].zw;
+    }
+    vec2 p = (q + glyph_offset) * view_scale + view_offset;
+    gl_Position = vec4(2.0 * p - vec2(1.), 0.0, 1.0);
+})raw";
+
+static const char* quad_vertex_src = R"raw(#version 330 core
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texcoord;
+
+out vec2 uv;
+
+uniform vec2 view_scale;
+uniform vec2 view_offset;
+
+void main() {
+    uv = texcoord;
+    vec2 p = position * view_scale + view_offset;
+    gl_Position = vec4(2.0 * p - vec2(1.), 0.0, 1.0);
+})raw";
+
+static const char* quad_fragment_src = R"raw(#version 330 core
+in vec2 uv;
+out vec4 color;
+
+uniform sampler2D atlas;
+
+void main() {
+    color = vec4(0.6, 0.6, 0.6, texture(atlas, uv).r);
+})raw";
+
+// color atlases hold premultiplied BGRA, uploaded swizzled to RGBA
+static const char* color_quad_fragment_src = R"raw(#version 330 core
+in vec2 uv;
+out vec4 color;
+
+uniform sampler2D atlas;
+
+void main() {
+    vec4 texel = texture(atlas, uv);
+    color = texel.a > 0.0 ? vec4(texel.rgb / texel.a, texel.a) : vec4(0.0);
+})raw";
+
+static const char* color_fragment_src = R"raw(#version 330 core
+out vec4 color;
+
+uniform vec4 line_color;
+
+void main() {
+    color = line_color;
+})raw";
+
+static const char* marker_vertex_src = R"raw(#version 330 core
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec2 center;
+
+uniform vec2 view_scale;
+uniform vec2 view_offset;
+uniform vec2 points_offset;
+uniform vec2 marker_size;
+
+out vec2 local;
+
+void main() {
+    local = corner;
+    vec2 p = (center + points_offset) * view_scale + view_offset;
+    gl_Position = vec4(2.0 * p - vec2(1.) + corner * marker_size, 0.0, 1.0);
+})raw";
+
+static const char* marker_fragment_src = R"raw(#version 330 core
+in vec2 local;
+out vec4 color;
+
+uniform vec4 marker_color;
+uniform bool round_marker;
+
+void main() {
+    if (round_marker && dot(local, local) > 1.0) discard;
+    color = marker_color;
+})raw";
+
+// Wide lines: every vertex shader places one corner of the quad of a segment
+// with expand, the corner going from -1 to 1 along the segment and across it
+static const char* wide_line_src = R"raw(#version 330 core
+layout(location = 0) in vec2 corner;
+
+uniform vec2 viewport_size;
+uniform float line_width;
+
+out vec2 edge;       // pixels along the segment from its start, and across from its center
+flat out float len;  // pixels
+
+void expand(vec2 a, vec2 b) {
+    vec2 pa = a * viewport_size;
+    vec2 pb = b * viewport_size;
+    len = length(pb - pa);
+    vec2 dir = len > 0.0 ? (pb - pa) / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(-dir.y, dir.x);
+    // a pixel beyond the half width holds the coverage ramp, and the square caps fill the joins of strips
+    float extent = 0.5 * line_width + 1.0;
+    float t = 0.5 * corner.x + 0.5;
+    edge = vec2(mix(-extent, len + extent, t), corner.y * extent);
+    vec2 p = mix(pa, pb, t) + corner.x * extent * dir + corner.y * extent * normal;
+    gl_Position = vec4(2.0 * p / viewport_size - vec2(1.), 0.0, 1.0);
+}
+
+// collapses the quad of the segment crossing a primitive restart
+void skip() {
+    edge = vec2(0.0);
+    len = 0.0;
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+}
+)raw";
+
+// ends of the segment as instance attributes, for strips and line lists
+static const char* wide_segment_src = R"raw(
+layout(location = 1) in vec2 a;
+layout(location = 2) in vec2 b;
+
+uniform vec2 view_scale;
+uniform vec2 view_offset;
+uniform vec2 points_offset;
+
+void main() {
+    expand((a + points_offset) * view_scale + view_offset, (b + points_offset) * view_scale + view_offset);
+})raw";
+
+// segments of an indexed strip, the glyph offset advancing once all the segments of the glyph are drawn
+static const char* wide_glyph_src = R"raw(
+layout(location = 1) in vec2 instance_offset;
+
+uniform samplerBuffer points;
+uniform usamplerBuffer indices;
+uniform int first_index;
+uniform int base_vertex;
+uniform int segments;
+uniform vec2 view_scale;
+uniform vec2 view_offset;
+
+void main() {
+    int s = first_index + gl_InstanceID % segments;
+    uint i = texelFetch(indices, s).r;
+    uint j = texelFetch(indices, s + 1).r;
+    if (i == 0xFFFFFFFFu || j == 0xFFFFFFFFu) {
+        skip();
+        return;
+    }
+    vec2 a = texelFetch(points, int(i) + base_vertex).xy + instance_offset;
+    vec2 b = texelFetch(points, int(j) + base_vertex).xy + instance_offset;
+    expand(a * view_scale + view_offset, b * view_scale + view_offset);
+})raw";
+
+// same as delta_vertex_src for the two ends of the segment
+static const char* wide_delta_src = R"raw(
+uniform samplerBuffer points;
+uniform usamplerBuffer indices;
+uniform samplerBuffer deltas;
+uniform vec2 view_scale;
+uniform vec2 view_offset;
+uniform vec2 glyph_offset;
+uniform vec4 axis_coords;
+
+vec2 interpolate(uint v) {
+    vec2 q = texelFetch(points, int(v)).xy;
+    for (int i = 0; i < 4; i++) {
+        vec4 d = texelFetch(deltas, 4 * int(v) + i);
+        float c = axis_coords[i];
+        q += c < 0.0 ? -c * d.xy : c * d.zw;
+    }
+    return (q + glyph_offset) * view_scale + view_offset;
+}
+
+void main() {
+    uint i = texelFetch(indices, gl_InstanceID).r;
+    uint j = texelFetch(indices, gl_InstanceID + 1).r;
+    if (i == 0xFFFFFFFFu || j == 0xFFFFFFFFu) {
+        skip();
+        return;
+    }
+    expand(interpolate(i), interpolate(j));
+})raw";
+
+static const char* wide_fragment_src = R"raw(#version 330 core
+in vec2 edge;
+flat in float len;
+out vec4 color;
+
+uniform vec4 line_color;
+uniform float line_width;
+
+void main() {
+    // distance to the center line, past the ends the caps are square
+    float beyond = max(-edge.x, edge.x - len);
+    float d = max(abs(edge.y), beyond);
+    float coverage = clamp(0.5 * line_width + 0.5 - d, 0.0, 1.0);
+    color = vec4(line_color.rgb, line_color.a * coverage);
+})raw";
+
+LineRenderer::LineRenderer(ProgramCache& programs): stream(stream_section_size), view_scale(1, 1), view_offset(0, 0), line_width(0), n_handle_vertices(0), n_on_curve(0), n_off_curve(0), n_delta_indices(0) {
+    program = programs.program(vertex_src, fragment_src);
+    instanced_program = programs.program(instanced_vertex_src, color_fragment_src);
+    quad_program = programs.program(quad_vertex_src, quad_fragment_src);
+    color_quad_program = programs.program(quad_vertex_src, color_quad_fragment_src);
+    handle_program = programs.program(instanced_vertex_src, color_fragment_src);
+    marker_program = programs.program(marker_vertex_src, marker_fragment_src);
+    delta_program = programs.program(delta_vertex_src, fragment_src);
+    wide_segment_program = programs.program((std::string(wide_line_src) + wide_segment_src).c_str(), wide_fragment_src);
+    wide_glyph_program = programs.program((std::string(wide_line_src) + wide_glyph_src).c_str(), wide_fragment_src);
+    wide_delta_program = programs.program((std::string(wide_line_src) + wide_delta_src).c_str(), wide_fragment_src);
+
+    for (unsigned int p : {quad_program, color_quad_program}) {
+        glUseProgram(p);
+        glUniform1i(glGetUniformLocation(p, "atlas"), 0);
+    }
+    // buffer textures go after the atlas
+    for (unsigned int p : {wide_glyph_program, wide_delta_program}) {
+        glUseProgram(p);
+        glUniform1i(glGetUniformLocation(p, "points"), 1);
+        glUniform1i(glGetUniformLocation(p, "indices"), 2);
+        glUniform1i(glGetUniformLocation(p, "deltas"), 3);
+    }
+    glUseProgram(0);
+
+    // streamed attributes are pointed into the ring by submit
+    glGenVertexArrays(1, &quad_vao);
+    glBindVertexArray(quad_vao);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    glGenVertexArrays(1, &instanced_vao);
+    glBindVertexArray(instanced_vao);
+    glEnableVertexAttribArray(0);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(1);
+
+    glGenBuffers(1, &control_vbo);
+
+    // handles use the instanced program with the offset as a constant attribute
+    glGenVertexArrays(1, &handle_vao);
+    glBindVertexArray(handle_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, control_vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glGenVertexArrays(1, &overlay_vao);
+    glBindVertexArray(overlay_vao);
+    glEnableVertexAttribArray(0);
+
+    const float corners[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+    glGenVertexArrays(1, &marker_vao);
+    glBindVertexArray(marker_vao);
+    glGenBuffers(1, &marker_corner_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, marker_corner_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    memory_usage.setBuffer(marker_corner_vbo, "marker corners", sizeof(corners));
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, control_vbo);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(1);
+
+    glGenVertexArrays(1, &delta_vao);
+    glBindVertexArray(delta_vao);
+    glGenBuffers(1, &delta_vertex_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, delta_vertex_vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+    glGenBuffers(1, &delta_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, delta_vbo);
+    for (unsigned int i = 0; i < max_delta_axes; i++) {
+        glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, max_delta_axes*sizeof(glm::vec4), (void*)(i*sizeof(glm::vec4)));
+        glEnableVertexAttribArray(1 + i);
+    }
+    glGenBuffers(1, &delta_ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, delta_ebo);
+
+    // the segment ends and glyph offsets of wide lines are pointed at their buffers by submit
+    glGenVertexArrays(1, &segment_vao);
+    glBindVertexArray(segment_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, marker_corner_vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+    for (unsigned int i = 1; i <= 2; i++) {
+        glVertexAttribDivisor(i, 1);
+        glEnableVertexAttribArray(i);
+    }
+
+    glGenVertexArrays(1, &wide_glyph_vao);
+    glBindVertexArray(wide_glyph_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, marker_corner_vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    glGenVertexArrays(1, &corner_vao);
+    glBindVertexArray(corner_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, marker_corner_vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    unsigned int textures[5];
+    glGenTextures(5, textures);
+    point_texture = textures[0];
+    index_texture = textures[1];
+    delta_point_texture = textures[2];
+    delta_index_texture = textures[3];
+    delta_texture = textures[4];
+
+    glGenBuffers(1, &indirect_buffer);
+}
+
+void LineRenderer::setLineWidth(float pixels) {
+    line_width = pixels;
+}
+
+void LineRenderer::setView(glm::vec2 scale, glm::vec2 offset) {
+    view_scale = scale;
+    view_offset = offset;
+}
+
+LineStrip LineRenderer::createLineStrip(const glm::vec2 *points, unsigned int npoints) {
+    LineStrip strip;
+    strip.n_points = npoints;
+    glGenVertexArrays(1, &strip.vao);
+    glBindVertexArray(strip.vao);
+
+    glGenBuffers(1, &strip.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, strip.vbo);
+    glBufferData(GL_ARRAY_BUFFER, npoints*sizeof(glm::vec2), points, GL_STATIC_DRAW);
+    memory_usage.setBuffer(strip.vbo, "line strip", npoints*sizeof(glm::vec2));
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+
+    return strip;
+}
+
+void LineRenderer::destroyLineStrip(LineStrip& strip) {
+    memory_usage.releaseBuffer(strip.vbo);
+    glDeleteBuffers(1, &strip.vbo);
+    glDeleteVertexArrays(1, &strip.vao);
+    strip.n_points = 0;
+}
+
+LineRenderer::DrawCommand& LineRenderer::record(DrawCommand::Kind kind, int layer, unsigned int program, unsigned int vao) {
+    DrawCommand command;
+    command.kind = kind;
+    command.layer = layer;
+    command.program = program;
+    command.vao = vao;
+    command.texture = 0;
+    command.arena = nullptr;
+    command.source = 0;
+    command.first = command.count = command.index_offset = command.index_count = 0;
+    command.base_vertex = 0;
+    command.view_scale = view_scale;
+    command.view_offset = view_offset;
+    command.offset = glm::vec2(0, 0);
+    command.color = glm::vec4(0, 0, 0, 1);
+    command.marker_size = glm::vec2(0, 0);
+    command.round = false;
+    command.width = line_width;
+    commands.push_back(command);
+    return commands.back();
+}
+
+void LineRenderer::drawLineStrip(const LineStrip& strip) {
+    if (line_width > 0) {
+        // strips are already in the window square
+        DrawCommand& command = record(DrawCommand::Strip, overlay_layer, wide_segment_program, segment_vao);
+        command.source = strip.vbo;
+        command.count = strip.n_points;
+        command.view_scale = glm::vec2(1, 1);
+        command.view_offset = glm::vec2(0, 0);
+        return;
+    }
+    DrawCommand& command = record(DrawCommand::Strip, overlay_layer, program, strip.vao);
+    command.count = strip.n_points;
+}
+
+void LineRenderer::drawAtlasQuads(const GlyphAtlas& atlas, const std::vector<AtlasQuad>& quads) {
+    if (quads.empty()) return;
+
+    size_t first = quad_vertices.size() / 4;
+    for (const AtlasQuad& quad : quads) {
+        const AtlasRegion& r = quad.entry->region;
+        float u0 = (float)r.x / (float)atlas.width();
+        float u1 = (float)(r.x + r.w) / (float)atlas.width();
+        float v0 = (float)r.y / (float)atlas.height();
+        float v1 = (float)(r.y + r.h) / (float)atlas.height();
+
+        // bitmap rows go top to bottom, so the first row maps to max.y
+        const float corners[6][4] = {
+            {quad.min.x, quad.min.y, u0, v1},
+            {quad.max.x, quad.min.y, u1, v1},
+            {quad.max.x, quad.max.y, u1, v0},
+            {quad.min.x, quad.min.y, u0, v1},
+            {quad.max.x, quad.max.y, u1, v0},
+            {quad.min.x, quad.max.y, u0, v0},
+        };
+        for (const auto& corner : corners) {
+            quad_vertices.insert(quad_vertices.end(), corner, corner + 4);
+        }
+    }
+
+    DrawCommand& command = record(DrawCommand::Quads, backdrop_layer, atlas.channels() == 4 ? color_quad_program : quad_program, quad_vao);
+    command.texture = atlas.texture();
+    command.first = first;
+    command.count = quad_vertices.size() / 4 - first;
+}
+
+void LineRenderer::drawGlyphInstances(const GlyphCache& cache, const std::vector<GlyphInstance>& instances, glm::vec4 color) {
+    if (instances.empty()) return;
+
+    // group the instances by glyph so that each glyph is drawn with one call
+    sorted_instances = instances;
+    std::sort(sorted_instances.begin(), sorted_instances.end(), [](const GlyphInstance& a, const GlyphInstance& b) {
+        return a.glyph_index < b.glyph_index;
+    });
+
+    size_t first = 0;
+    while (first < sorted_instances.size()) {
+        unsigned int glyph_index = sorted_instances[first].glyph_index;
+        size_t last = first;
+        while (last < sorted_instances.size() && sorted_instances[last].glyph_index == glyph_index) last++;
+
+        // a glyph missing from the cache is skipped rather than drawn from a stale range
+        const GlyphGeometry* geometry = cache.find(glyph_index);
+        if (!geometry) {
+            first = last;
+            continue;
+        }
+        DrawCommand& command = line_width > 0 ? record(DrawCommand::Glyphs, glyph_layer, wide_glyph_program, wide_glyph_vao)
+                                              : record(DrawCommand::Glyphs, glyph_layer, instanced_program, instanced_vao);
+        command.arena = &cache.geometryArena();
+        command.first = instance_offsets.size();
+        command.count = last - first;
+        command.index_offset = geometry->index_offset;
+        command.index_count = geometry->index_count;
+        command.base_vertex = (int)geometry->base_vertex;
+        command.color = color;
+        for (size_t i = first; i < last; i++) {
+            instance_offsets.push_back(sorted_instances[i].offset);
+        }
+
+        first = last;
+    }
+}
+
+void LineRenderer::setControlPoints(const ControlPoints& points) {
+    n_handle_vertices = points.handles.size();
+    n_on_curve = points.on_curve.size();
+    n_off_curve = points.off_curve.size();
+
+    std::vector<glm::vec2> vertices;
+    vertices.reserve(n_handle_vertices + n_on_curve + n_off_curve);
+    vertices.insert(vertices.end(), points.handles.begin(), points.handles.end());
+    vertices.insert(vertices.end(), points.on_curve.begin(), points.on_curve.end());
+    vertices.insert(vertices.end(), points.off_curve.begin(), points.off_curve.end());
+
+    glBindBuffer(GL_ARRAY_BUFFER, control_vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(glm::vec2), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    memory_usage.setBuffer(control_vbo, "control points", vertices.size()*sizeof(glm::vec2));
+}
+
+void LineRenderer::drawControlPoints(glm::vec2 offset) {
+    if (n_handle_vertices > 0) {
+        DrawCommand& command = line_width > 0 ? record(DrawCommand::Handles, overlay_layer, wide_segment_program, segment_vao)
+                                              : record(DrawCommand::Handles, overlay_layer, handle_program, handle_vao);
+        command.count = n_handle_vertices;
+        command.offset = offset;
+        command.color = glm::vec4(0.5f, 0.5f, 0.5f, 1.f);
+    }
+
+    // markers keep a constant size in pixels whatever the view
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    struct Category {
+        size_t first, count;
+        float size;
+        float r, g, b;
+        bool round;
+    };
+    const Category categories[] = {
+        {n_handle_vertices, n_on_curve, on_curve_marker_size, 0.8f, 0.1f, 0.1f, false},
+        {n_handle_vertices + n_on_curve, n_off_curve, off_curve_marker_size, 0.1f, 0.3f, 0.8f, true},
+    };
+    for (const Category& category : categories) {
+        if (category.count == 0) continue;
+
+        DrawCommand& command = record(DrawCommand::Markers, overlay_layer, marker_program, marker_vao);
+        command.source = control_vbo;
+        command.first = category.first;
+        command.count = category.count;
+        command.offset = offset;
+        command.marker_size = glm::vec2(category.size / (float)viewport[2], category.size / (float)viewport[3]);
+        command.color = glm::vec4(category.r, category.g, category.b, 1.f);
+        command.round = category.round;
+    }
+}
+
+void LineRenderer::setDeltaGlyph(const DeltaGlyph& glyph) {
+    n_delta_indices = glyph.indices.size();
+
+    glBindVertexArray(delta_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, delta_vertex_vbo);
+    glBufferData(GL_ARRAY_BUFFER, glyph.vertices.size()*sizeof(glm::vec2), glyph.vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, delta_vbo);
+    glBufferData(GL_ARRAY_BUFFER, glyph.deltas.size()*sizeof(glm::vec4), glyph.deltas.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, glyph.indices.size()*sizeof(unsigned int), glyph.indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    memory_usage.setBuffer(delta_vertex_vbo, "delta glyph vertices", glyph.vertices.size()*sizeof(glm::vec2));
+    memory_usage.setBuffer(delta_vbo, "delta glyph deltas", glyph.deltas.size()*sizeof(glm::vec4));
+    memory_usage.setBuffer(delta_ebo, "delta glyph indices", glyph.indices.size()*sizeof(unsigned int));
+
+    // the buffers keep their names, so the textures of wide lines stay attached to them
+    const struct { unsigned int texture; GLenum format; unsigned int buffer; } views[] = {
+        {delta_point_texture, GL_RG32F, delta_vertex_vbo},
+        {delta_index_texture, GL_R32UI, delta_ebo},
+        {delta_texture, GL_RGBA32F, delta_vbo},
+    };
+    for (const auto& view : views) {
+        glBindTexture(GL_TEXTURE_BUFFER, view.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, view.format, view.buffer);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LineRenderer::drawDeltaGlyph(glm::vec2 offset, glm::vec4 axis_coords) {
+    if (n_delta_indices == 0) return;
+
+    DrawCommand& command = line_width > 0 ? record(DrawCommand::Delta, glyph_layer, wide_delta_program, corner_vao)
+                                          : record(DrawCommand::Delta, glyph_layer, delta_program, delta_vao);
+    command.count = n_delta_indices;
+    command.offset = offset;
+    command.color = axis_coords;
+}
+
+void LineRenderer::drawLines(const std::vector<glm::vec2>& ends, glm::vec2 offset, glm::vec4 color) {
+    if (ends.empty()) return;
+
+    DrawCommand& command = line_width > 0 ? record(DrawCommand::Lines, overlay_layer, wide_segment_program, segment_vao)
+                                          : record(DrawCommand::Lines, overlay_layer, handle_program, overlay_vao);
+    command.first = overlay_points.size();
+    command.count = ends.size();
+    command.offset = offset;
+    command.color = color;
+    overlay_points.insert(overlay_points.end(), ends.begin(), ends.end());
+}
+
+void LineRenderer::drawMarkers(const std::vector<glm::vec2>& centers, glm::vec2 offset, float size, glm::vec4 color, bool round) {
+    if (centers.empty()) return;
+
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    DrawCommand& command = record(DrawCommand::Markers, overlay_layer, marker_program, marker_vao);
+    command.first = overlay_points.size();
+    command.count = centers.size();
+    command.offset = offset;
+    command.marker_size = glm::vec2(size / (float)viewport[2], size / (float)viewport[3]);
+    command.color = color;
+    command.round = round;
+    overlay_points.insert(overlay_points.end(), centers.begin(), centers.end());
+}
+
+bool LineRenderer::sameGlyphBatch(const DrawCommand& a, const DrawCommand& b) {
+    return b.kind == DrawCommand::Glyphs && b.width == 0 && a.program == b.program && a.vao == b.vao && a.arena == b.arena &&
+           a.color == b.color && a.view_scale == b.view_scale && a.view_offset == b.view_offset;
+}
+
+void LineRenderer::submit() {
+    if (commands.empty()) return;
+
+    size_t quad_base = stream.write(quad_vertices.data(), quad_vertices.size()*sizeof(float));
+    size_t instance_base = stream.write(instance_offsets.data(), instance_offsets.size()*sizeof(glm::vec2));
+    size_t overlay_base = stream.write(overlay_points.data(), overlay_points.size()*sizeof(glm::vec2));
+    // writes may have replaced the buffer, so the streamed attributes are pointed at it every frame
+    unsigned int stream_vbo = stream.buffer();
+    glBindBuffer(GL_ARRAY_BUFFER, stream_vbo);
+    if (!quad_vertices.empty()) {
+        glBindVertexArray(quad_vao);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)quad_base);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(quad_base + 2*sizeof(float)));
+    }
+    if (!overlay_points.empty()) {
+        glBindVertexArray(overlay_vao);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)overlay_base);
+    }
+    glBindVertexArray(0);
+
+    std::stable_sort(commands.begin(), commands.end(), [](const DrawCommand& a, const DrawCommand& b) {
+        if (a.layer != b.layer) return a.layer < b.layer;
+        if (a.program != b.program) return a.program < b.program;
+        if (a.vao != b.vao) return a.vao < b.vao;
+        return a.texture < b.texture;
+    });
+
+    // the base instance selects the offsets of each glyph, so the instance attribute is never rebased
+    bool indirect = gl_ext.multi_draw_indirect;
+    if (indirect) {
+        indirect_commands.clear();
+        for (const DrawCommand& command : commands) {
+            if (command.kind != DrawCommand::Glyphs || command.width > 0) continue;
+            indirect_commands.push_back(DrawElementsIndirectCommand{(GLuint)command.index_count, (GLuint)command.count,
+                                                                    (GLuint)command.index_offset, command.base_vertex, (GLuint)command.first});
+        }
+        if (!indirect_commands.empty()) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, indirect_commands.size()*sizeof(DrawElementsIndirectCommand), indirect_commands.data(), GL_STREAM_DRAW);
+            memory_usage.setBuffer(indirect_buffer, "indirect commands", indirect_commands.size()*sizeof(DrawElementsIndirectCommand));
+        }
+    }
+    size_t n_glyph_commands = 0;
+
+    // wide lines are sized in pixels of the viewport
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    const DrawCommand* previous = nullptr;
+    bool restart = false;
+    // arena buffers attached to instanced_vao, which change when an arena grows
+    unsigned int arena_vbo = 0, arena_ebo = 0;
+    // and to the buffer textures of wide lines, bound to units 1 and 2 for a glyph or delta command
+    unsigned int texture_vbo = 0, texture_ebo = 0;
+    unsigned int bound_points = 0;
+    for (size_t i = 0; i < commands.size(); i++) {
+        const DrawCommand& command = commands[i];
+        unsigned int p = command.program;
+        bool program_changed = !previous || previous->program != p;
+        if (program_changed) {
+            glUseProgram(p);
+        }
+        if (program_changed || previous->view_scale != command.view_scale || previous->view_offset != command.view_offset) {
+            glUniform2f(glGetUniformLocation(p, "view_scale"), command.view_scale.x, command.view_scale.y);
+            glUniform2f(glGetUniformLocation(p, "view_offset"), command.view_offset.x, command.view_offset.y);
+        }
+        if (!previous || previous->vao != command.vao) {
+            glBindVertexArray(command.vao);
+        }
+        if (command.texture && (!previous || previous->texture != command.texture)) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, command.texture);
+        }
+
+        bool wide = command.width > 0;
+        if (wide) {
+            glUniform2f(glGetUniformLocation(p, "viewport_size"), (float)viewport[2], (float)viewport[3]);
+            glUniform1f(glGetUniformLocation(p, "line_width"), command.width);
+        }
+
+        bool indexed = !wide && (command.kind == DrawCommand::Glyphs || command.kind == DrawCommand::Delta);
+        if (indexed != restart) {
+            restart = indexed;
+            if (restart) {
+                glEnable(GL_PRIMITIVE_RESTART);
+                glPrimitiveRestartIndex(restart_index);
+            } else {
+                glDisable(GL_PRIMITIVE_RESTART);
+            }
+        }
+
+        const glm::vec4& c = command.color;
+        switch (command.kind) {
+        case DrawCommand::Strip:
+            if (wide) {
+                if (command.count < 2) break;
+                glUniform4f(glGetUniformLocation(p, "line_color"), c.x, c.y, c.z, c.w);
+                glUniform2f(glGetUniformLocation(p, "points_offset"), 0.f, 0.f);
+                glBindBuffer(GL_ARRAY_BUFFER, command.source);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void*)sizeof(glm::vec2));
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (int)command.count - 1);
+                break;
+            }
+            glDrawArrays(GL_LINE_STRIP, 0, (int)command.count);
+            break;
+        case DrawCommand::Quads:
+            glDrawArrays(GL_TRIANGLES, (int)command.first, (int)command.count);
+            break;
+        case DrawCommand::Glyphs:
+            if (wide) {
+                if (command.index_count < 2) break;
+                if (command.arena->vbo() != texture_vbo || command.arena->ebo() != texture_ebo) {
+                    texture_vbo = command.arena->vbo();
+                    texture_ebo = command.arena->ebo();
+                    glBindTexture(GL_TEXTURE_BUFFER, point_texture);
+                    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, texture_vbo);
+                    glBindTexture(GL_TEXTURE_BUFFER, index_texture);
+                    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, texture_ebo);
+                    bound_points = 0;
+                }
+                if (bound_points != point_texture) {
+                    bound_points = point_texture;
+                    glActiveTexture(GL_TEXTURE1);
+                    glBindTexture(GL_TEXTURE_BUFFER, point_texture);
+                    glActiveTexture(GL_TEXTURE2);
+                    glBindTexture(GL_TEXTURE_BUFFER, index_texture);
+                    glActiveTexture(GL_TEXTURE0);
+                }
+                int segments = (int)command.index_count - 1;
+                glUniform4f(glGetUniformLocation(p, "line_color"), c.x, c.y, c.z, c.w);
+                glUniform1i(glGetUniformLocation(p, "first_index"), (int)command.index_offset);
+                glUniform1i(glGetUniformLocation(p, "base_vertex"), command.base_vertex);
+                glUniform1i(glGetUniformLocation(p, "segments"), segments);
+                glBindBuffer(GL_ARRAY_BUFFER, stream_vbo);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(instance_base + command.first*sizeof(glm::vec2)));
+                glVertexAttribDivisor(1, segments);
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, segments * (int)command.count);
+                break;
+            }
+            if (command.arena->vbo() != arena_vbo || command.arena->ebo() != arena_ebo) {
+                arena_vbo = command.arena->vbo();
+                arena_ebo = command.arena->ebo();
+                glBindBuffer(GL_ARRAY_BUFFER, arena_vbo);
+                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena_ebo);
+            }
+            glUniform4f(glGetUniformLocation(p, "line_color"), c.x, c.y, c.z, c.w);
+            glBindBuffer(GL_ARRAY_BUFFER, stream_vbo);
+            if (indirect) {
+                size_t last = i + 1;
+                while (last < commands.size() && sameGlyphBatch(command, commands[last])) last++;
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)instance_base);
+                gl_ext.MultiDrawElementsIndirect(GL_LINE_STRIP, GL_UNSIGNED_INT, (void*)(n_glyph_commands*sizeof(DrawElementsIndirectCommand)),
+                                                 (GLsizei)(last - i), 0);
+                n_glyph_commands += last - i;
+                i = last - 1;
+            } else {
+                // GL 3.3 has no base instance, so the per-instance attribute is rebased instead
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(instance_base + command.first*sizeof(glm::vec2)));
+                glDrawElementsInstancedBaseVertex(GL_LINE_STRIP, (int)command.index_count, GL_UNSIGNED_INT,
+                                                  (void*)(command.index_offset*sizeof(unsigned int)), (int)command.count, command.base_vertex);
+            }
+            break;
+        case DrawCommand::Handles:
+        case DrawCommand::Lines:
+            if (wide) {
+                // pairs of ends, one instance each
+                size_t base = (command.kind == DrawCommand::Lines ? overlay_base : 0) + command.first*sizeof(glm::vec2);
+                glUniform4f(glGetUniformLocation(p, "line_color"), c.x, c.y, c.z, c.w);
+                glUniform2f(glGetUniformLocation(p, "points_offset"), command.offset.x, command.offset.y);
+                glBindBuffer(GL_ARRAY_BUFFER, command.kind == DrawCommand::Lines ? stream_vbo : control_vbo);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2*sizeof(glm::vec2), (void*)base);
+                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2*sizeof(glm::vec2), (void*)(base + sizeof(glm::vec2)));
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (int)command.count / 2);
+                break;
+            }
+            glUniform4f(glGetUniformLocation(p, "line_color"), c.x, c.y, c.z, c.w);
+            glVertexAttrib2f(1, command.offset.x, command.offset.y);
+            glDrawArrays(GL_LINES, (int)command.first, (int)command.count);
+            break;
+        case DrawCommand::Markers:
+            glUniform2f(glGetUniformLocation(p, "points_offset"), command.offset.x, command.offset.y);
+            glUniform2f(glGetUniformLocation(p, "marker_size"), command.marker_size.x, command.marker_size.y);
+            glUniform4f(glGetUniformLocation(p, "marker_color"), c.x, c.y, c.z, c.w);
+            glUniform1i(glGetUniformLocation(p, "round_marker"), command.round);
+            if (command.source) {
+                glBindBuffer(GL_ARRAY_BUFFER, command.source);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(command.first*sizeof(glm::vec2)));
+            } else {
+                glBindBuffer(GL_ARRAY_BUFFER, stream_vbo);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(overlay_base + command.first*sizeof(glm::vec2)));
+            }
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (int)command.count);
+            break;
+        case DrawCommand::Delta:
+            glUniform2f(glGetUniformLocation(p, "glyph_offset"), command.offset.x, command.offset.y);
+            glUniform4f(glGetUniformLocation(p, "axis_coords"), c.x, c.y, c.z, c.w);
+            if (wide) {
+                if (command.count < 2) break;
+                bound_points = delta_point_texture;
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_BUFFER, delta_point_texture);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_BUFFER, delta_index_texture);
+                glActiveTexture(GL_TEXTURE3);
+                glBindTexture(GL_TEXTURE_BUFFER, delta_texture);
+                glActiveTexture(GL_TEXTURE0);
+                glUniform4f(glGetUniformLocation(p, "line_color"), 0.f, 0.f, 0.f, 1.f);
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (int)command.count - 1);
+                break;
+            }
+            glDrawElements(GL_LINE_STRIP, (int)command.count, GL_UNSIGNED_INT, (void*)0);
+            break;
+        }
+        previous = &commands[i];
+    }
+
+    if (restart) {
+        glDisable(GL_PRIMITIVE_RESTART);
+    }
+    if (indirect) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    stream.finishFrame();
+
+    commands.clear();
+    quad_vertices.clear();
+    instance_offsets.clear();
+    overlay_points.clear();
+}
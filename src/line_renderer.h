@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include "glyph_cache.h"
+#include "stream_buffer.h"
+
+class GlyphArena;
+class GlyphAtlas;
+class ProgramCache;
+struct AtlasEntry;
+struct ControlPoints;
+struct DeltaGlyph;
+struct DrawElementsIndirectCommand;
+
+struct LineStrip {
+    unsigned int vao, vbo;
+    unsigned int n_points;
+};
+
+struct AtlasQuad {
+    glm::vec2 min, max;
+    const AtlasEntry* entry;
+};
+
+// The draw methods only record commands, which submit issues once per frame.
+// Commands are drawn by layer, atlas backdrops first, then glyph outlines,
+// then overlays such as lines and markers. Within a layer they are sorted by
+// program, vertex array and texture so that consecutive draws share their
+// state, commands with the same state keeping the order they were recorded in.
+// When the context has multi-draw indirect, consecutive glyph draws sharing
+// their color and view are issued with a single call whatever their number.
+//
+// Lines wider than zero pixels are drawn as one instanced quad per segment,
+// expanded in screen space and anti-aliased in the fragment shader, so their
+// thickness does not depend on glLineWidth support. Glyph and delta outlines,
+// being indexed strips, read their segments from buffer textures and are drawn
+// with one call per glyph instead of a shared indirect call.
+class LineRenderer {
+public:
+    explicit LineRenderer(ProgramCache& programs);
+
+    // Issues the commands recorded since the last call, the viewport and
+    // scissor in effect being the ones of the call
+    void submit();
+
+    // Width in pixels of the lines recorded after the call, zero draws one pixel GL lines
+    void setLineWidth(float pixels);
+
+    void drawLineStrip(const LineStrip& strip);
+    LineStrip createLineStrip(const glm::vec2* points, unsigned int npoints);
+    void destroyLineStrip(LineStrip& strip);
+
+    // Draws every quad textured from the atlas in a single draw call, quads go through the view as well.
+    // Single channel atlases are drawn as a gray backdrop, color ones as they are.
+    void drawAtlasQuads(const GlyphAtlas& atlas, const std::vector<AtlasQuad>& quads);
+    // Draws all instances of a glyph with one instanced call, glyphs missing from the cache are skipped
+    void drawGlyphInstances(const GlyphCache& cache, const std::vector<GlyphInstance>& instances, glm::vec4 color = glm::vec4(0, 0, 0, 1));
+
+    // Uploads the control points of an outline, drawn by drawControlPoints until replaced
+    void setControlPoints(const ControlPoints& points);
+    // Draws the handles, the on-curve and the off-curve markers with one call
+    // each, the points being placed like a glyph instance at offset
+    void drawControlPoints(glm::vec2 offset);
+
+    // Uploads a variable glyph with its per-axis deltas, drawn by drawDeltaGlyph until replaced
+    void setDeltaGlyph(const DeltaGlyph& glyph);
+    // Draws the glyph interpolated on the GPU at the normalized coordinates of its first axes
+    void drawDeltaGlyph(glm::vec2 offset, glm::vec4 axis_coords);
+
+    // Draws pairs of segment ends, translated by offset before the view
+    void drawLines(const std::vector<glm::vec2>& ends, glm::vec2 offset, glm::vec4 color);
+    // Draws markers of size pixels, square or round, centered on the points translated by offset
+    void drawMarkers(const std::vector<glm::vec2>& centers, glm::vec2 offset, float size, glm::vec4 color, bool round);
+
+    // Maps instance space to the [0, 1] window square as p * scale + offset,
+    // for the draws recorded after the call
+    void setView(glm::vec2 scale, glm::vec2 offset);
+
+private:
+    struct DrawCommand {
+        enum Kind {
+            Strip,
+            Quads,
+            Glyphs,
+            Handles,
+            Lines,
+            Markers,
+            Delta,
+        };
+
+        Kind kind;
+        int layer;
+        unsigned int program, vao, texture;
+        const GlyphArena* arena;  // buffers of Glyphs, read at submit as the arena may grow before
+        unsigned int source;      // buffer of the centers of Markers, 0 for the overlay points, or of a wide Strip
+        size_t first, count;      // vertices, indices or instances depending on the kind
+        size_t index_offset, index_count;
+        int base_vertex;
+        glm::vec2 view_scale, view_offset;
+        glm::vec2 offset;
+        glm::vec4 color;  // axis coordinates for Delta
+        glm::vec2 marker_size;
+        bool round;
+        float width;  // pixels, zero for GL lines
+    };
+
+    DrawCommand& record(DrawCommand::Kind kind, int layer, unsigned int program, unsigned int vao);
+    // True if b can be drawn in the same indirect call as the glyph command a
+    static bool sameGlyphBatch(const DrawCommand& a, const DrawCommand& b);
+
+    unsigned int program;
+    unsigned int instanced_program;
+    unsigned int instanced_vao;
+    std::vector<GlyphInstance> sorted_instances;
+    // streamed data of the recorded commands, written once into the ring by submit
+    StreamBuffer stream;
+    std::vector<glm::vec2> instance_offsets;
+    std::vector<glm::vec2> overlay_points;
+    std::vector<DrawCommand> commands;
+    // one per glyph command, in submission order
+    std::vector<DrawElementsIndirectCommand> indirect_commands;
+    unsigned int indirect_buffer;
+    glm::vec2 view_scale, view_offset;
+    unsigned int quad_program, color_quad_program;
+    unsigned int quad_vao;
+    std::vector<float> quad_vertices;
+
+    // handles, then on-curve points, then off-curve points
+    unsigned int handle_program, marker_program;
+    unsigned int handle_vao, marker_vao, marker_corner_vbo, control_vbo;
+    // streamed geometry of drawLines and drawMarkers
+    unsigned int overlay_vao;
+
+    // wide lines, quads being made of the marker corners
+    float line_width;
+    unsigned int wide_segment_program, wide_glyph_program, wide_delta_program;
+    unsigned int segment_vao, wide_glyph_vao, corner_vao;
+    // buffer textures of the arena being drawn and of the delta glyph
+    unsigned int point_texture, index_texture;
+    unsigned int delta_point_texture, delta_index_texture, delta_texture;
+    size_t n_handle_vertices, n_on_curve, n_off_curve;
+
+    unsigned int delta_program;
+    unsigned int delta_vao, delta_vertex_vbo, delta_vbo, delta_ebo;
+    size_t n_delta_indices;
+};
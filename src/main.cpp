@@ -1,273 +1,1051 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "ft2build.h"
 #include FT_FREETYPE_H
-#include FT_OUTLINE_H
-#define GLAD_GL_IMPLEMENTATION
+#include FT_MULTIPLE_MASTERS_H
 #include "glad.h"
 #include "GLFW/glfw3.h"
 #include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
 
-static const char* vertex_src = R"raw(#version 330 core
-layout(location = 0) in vec2 position;
+#include "axis_sliders.h"
+#include "color_glyphs.h"
+#include "gl_extensions.h"
+#include "coverage.h"
+#include "font_index.h"
+#include "font_set.h"
+#include "glyph_arena.h"
+#include "glyph_atlas.h"
+#include "glyph_cache.h"
+#include "glyph_deltas.h"
+#include "glyph_disk_cache.h"
+#include "glyph_lod.h"
+#include "line_renderer.h"
+#include "mapped_file.h"
+#include "memory_usage.h"
+#include "offscreen.h"
+#include "outline.h"
+#include "outline_export.h"
+#include "outline_index.h"
+#include "program_cache.h"
+#include "proof.h"
+#include "text_layout.h"
+#include "text_stream.h"
+#include "variations.h"
 
-void main() {
-    gl_Position = vec4(2.0 * position - vec2(1.), 0.0, 1.0);
-})raw";
+static const int window_size = 600;
+static const int raster_size = 48;
+// Flattening error allowed on screen before a finer level of detail is used
+static const float lod_pixel_tolerance = 0.5f;
+static const float zoom_step = 1.1f;
+static const float pick_radius = 8.f;  // pixels
+static const float highlight_marker_size = 11.f;
+static const glm::vec4 highlight_color(1.f, 0.6f, 0.f, 0.8f);
+static const unsigned int stream_visible_lines = 50;
+static const unsigned int stream_prefetch_lines = 50;
+static const int proof_tile_size = 256;
+// pixels per em of the hinted outlines compared with the design ones in glyph mode
+static const unsigned int min_hinted_size = 6;
+static const unsigned int max_hinted_size = 200;
+// pixels, zero draws GL lines
+static const float default_line_width = 2.f;
+static const float max_line_width = 16.f;
+static const glm::vec4 unhinted_color(0.6f, 0.6f, 0.6f, 1.f);
+static const glm::vec4 pixel_grid_color(0.f, 0.4f, 1.f, 0.15f);
 
-static const char* fragment_src = R"raw(#version 330 core
-out vec4 color;
+static double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+enum class Mode {
+    Glyph,
+    Text,
+    Stream,
+    Proof,
+};
 
-void main() {
-    color = vec4(0.0, 0.0, 0.0, 1.0);
-})raw";
+// Another face shown next to the main one in glyph mode
+struct ComparedFace {
+    FT_Face face;
+    std::unique_ptr<GlyphCache> glyph_cache;
+    unsigned int glyph_index;
+};
 
-struct LineStrip {
-    unsigned int vao, vbo;
-    unsigned int n_points;
+// Font file given on the command line or found in the index by name
+struct FontSource {
+    std::string path;
+    long face_index;  // negative for every face of the file
 };
 
-class LineRenderer {
-public:
-    LineRenderer();
+struct Context {
+    LineRenderer& renderer;
+    FT_Face& face;
+    const Coverage& coverage;
+    GlyphAtlas& atlas;
+    GlyphAtlas& color_atlas;
+    unsigned int codepoint;
+    unsigned int glyph_index;
+    // the current glyph is drawn from its COLR layers or its bitmap when it has one
+    std::vector<ColorLayer> color_layers;
+    bool bitmap_glyph;
+    bool show_control_points;
+    OutlineIndex outline_index;
+    OutlinePick hovered;
+
+    GlyphCache& glyph_cache;
+    // shown over the design outline when its pixel size is not 0
+    GlyphCache& hinted_cache;
+    Mode mode;
+    std::string text;
+    TextLayout layout;
+    TextStreamView* stream_view;
 
-    void drawLineStrip(const LineStrip& strip);
-    LineStrip createLineStrip(const glm::vec2* points, unsigned int npoints);
+    // view of the current mode, zoomed and panned around the window center
+    glm::vec2 view_scale, view_offset;
+    float zoom;
+    glm::vec2 pan;
+    bool dragging;
+    glm::vec2 drag_position;
 
-private:
-    unsigned int program;
+    // null for static fonts
+    AxisSliders* sliders;
+    InstanceWorker* instance_worker;
+    std::vector<VariationAxis> axes;
+    // glyph mode interpolates the glyph in the vertex shader instead of flattening instances
+    bool gpu_variations;
+    bool has_deltas;
+    glm::vec4 axis_coords;
+
+    std::vector<ComparedFace>& compared;
+    // the budget could not be met by trimming the caches, which is only reported once
+    bool budget_exceeded = false;
 };
 
-LineRenderer::LineRenderer() {
-    unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_src, nullptr);
-    glCompileShader(vertex_shader);
+const AtlasEntry* rasterize_glyph(GlyphAtlas& atlas, FT_Face& face, unsigned int glyph_index) {
+    const AtlasEntry* entry = atlas.find(glyph_index);
+    if (entry) return entry;
 
-    unsigned int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_src, nullptr);
-    glCompileShader(fragment_shader);
+    // the raster is only a backdrop, glyphs without one are shown without it
+    FT_Error err = FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER | FT_LOAD_NO_HINTING);
+    if (err || face->glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY) return nullptr;
 
-    int ret;
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &ret);
-    if (!ret) {
-        std::cerr << "vertex shader compilation failed" << std::endl;
-        std::exit(1);
+    const FT_Bitmap& bitmap = face->glyph->bitmap;
+    entry = atlas.insert(glyph_index, bitmap.buffer, bitmap.width, bitmap.rows, bitmap.pitch, face->glyph->bitmap_left, face->glyph->bitmap_top);
+    if (!entry) {
+        std::cerr << "Glyph does not fit in the atlas" << std::endl;
     }
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &ret);
-    if (!ret) {
-        std::cerr << "fragment shader compilation failed" << std::endl;
-        std::exit(1);
+    return entry;
+}
+
+// Collects the points that flattening discards, and decomposes the glyph again for picking
+void load_control_points(Context& ctx) {
+    ControlPoints points;
+
+    FT_Error err = FT_Load_Glyph(ctx.face, ctx.glyph_index, FT_LOAD_NO_SCALE);
+    if (!err && ctx.face->glyph->format == FT_GLYPH_FORMAT_OUTLINE) {
+        OutlineState st;
+        st.origin = glm::vec2(0, 0);
+        st.scale = ctx.glyph_cache.height();
+        st.tolerance = base_tolerance;
+        collect_control_points(&ctx.face->glyph->outline, st.origin, st.scale, points);
+        decompose_outline(&ctx.face->glyph->outline, st);
+        ctx.outline_index.build(points, st.lines);
+    } else {
+        ctx.outline_index.build(points, {});
+    }
+
+    ctx.renderer.setControlPoints(points);
+}
+
+// Loads the raster backdrop and the control points of the glyph at the instance
+// interpolated on the GPU. The glyph caches stay on the default instance, so the
+// face is only set to the instance while the glyph is loaded.
+void load_gpu_instance(Context& ctx) {
+    std::vector<FT_Fixed> coords = ctx.sliders->coords();
+    std::vector<FT_Fixed> previous(coords.size());
+    FT_Get_Var_Design_Coordinates(ctx.face, previous.size(), previous.data());
+    FT_Set_Var_Design_Coordinates(ctx.face, coords.size(), coords.data());
+    ctx.atlas.clear();
+    rasterize_glyph(ctx.atlas, ctx.face, ctx.glyph_index);
+    load_control_points(ctx);
+    FT_Set_Var_Design_Coordinates(ctx.face, previous.size(), previous.data());
+}
+
+// Extracts the deltas of the glyph and checks them against FreeType
+void load_deltas(Context& ctx) {
+    DeltaGlyph glyph;
+    ctx.has_deltas = extract_glyph_deltas(ctx.face, ctx.glyph_index, ctx.axes, glyph);
+    if (!ctx.has_deltas) {
+        std::cerr << "Glyph " << ctx.glyph_index << " cannot be interpolated on the GPU" << std::endl;
+        return;
     }
+    ctx.renderer.setDeltaGlyph(glyph);
 
-    program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
+    size_t n_samples;
+    float error = measure_delta_error(ctx.face, ctx.glyph_index, ctx.axes, glyph, n_samples);
+    std::cout << "Glyph " << ctx.glyph_index << ": " << glyph.vertices.size() << " vertices, max delta error "
+              << error * ctx.glyph_cache.height() << " font units over " << n_samples << " instances" << std::endl;
 }
 
-LineStrip LineRenderer::createLineStrip(const glm::vec2 *points, unsigned int npoints) {
-    LineStrip strip;
-    strip.n_points = npoints;
-    glGenVertexArrays(1, &strip.vao);
-    glBindVertexArray(strip.vao);
+void load_character(Context& ctx, unsigned int codepoint) {
+    // faces without a Unicode charmap have an empty coverage and are looked up as before
+    if (ctx.coverage.count() > 0 && !ctx.coverage.contains(codepoint)) {
+        char name[16];
+        std::snprintf(name, sizeof(name), "U+%04X", codepoint);
+        std::cerr << name << " has no glyph in the font" << std::endl;
+        return;
+    }
 
-    glGenBuffers(1, &strip.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, strip.vbo);
-    glBufferData(GL_ARRAY_BUFFER, npoints*sizeof(glm::vec2), points, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glEnableVertexAttribArray(0);
+    ctx.codepoint = codepoint;
+    ctx.glyph_index = FT_Get_Char_Index(ctx.face, codepoint);
+    const GlyphGeometry* geometry;
+    GlyphStatus status = ctx.glyph_cache.load(ctx.glyph_index, geometry);
 
-    glBindVertexArray(0);
+    ctx.bitmap_glyph = false;
+    if (color_layers(ctx.face, ctx.glyph_index, ctx.color_layers)) {
+        for (const ColorLayer& layer : ctx.color_layers) {
+            ctx.glyph_cache.get(layer.glyph_index);
+        }
+    } else if (has_bitmap(ctx.face, ctx.glyph_index)) {
+        ctx.bitmap_glyph = true;
+    } else if (status != GlyphStatus::Ok) {
+        std::cerr << "Glyph " << ctx.glyph_index << " cannot be shown: " << glyph_status_name(status) << std::endl;
+    }
+    if (ctx.gpu_variations) {
+        load_deltas(ctx);
+        load_gpu_instance(ctx);
+    } else {
+        load_control_points(ctx);
+    }
 
-    return strip;
+    for (ComparedFace& compared : ctx.compared) {
+        compared.glyph_index = FT_Get_Char_Index(compared.face, codepoint);
+        compared.glyph_cache->get(compared.glyph_index);
+    }
 }
 
-void LineRenderer::drawLineStrip(const LineStrip& strip) {
-    glUseProgram(program);
-    glBindVertexArray(strip.vao);
-    glDrawArrays(GL_LINE_STRIP, 0, (int)strip.n_points);
-    glBindVertexArray(0);
+// Places the raster of a glyph in the same normalized space as its outline
+AtlasQuad raster_quad(const AtlasEntry* entry, FT_Face& face, float bearing_x) {
+    float units_per_pixel = (float)face->units_per_EM / (float)face->size->metrics.y_ppem;
+    float height = face->ascender - face->descender;
+
+    AtlasQuad quad;
+    quad.min.x = (float)entry->bearing_x * units_per_pixel / height - bearing_x;
+    quad.min.y = ((float)(entry->bearing_y - entry->region.h) * units_per_pixel - face->descender) / height;
+    quad.max.x = quad.min.x + (float)entry->region.w * units_per_pixel / height;
+    quad.max.y = quad.min.y + (float)entry->region.h * units_per_pixel / height;
+    quad.entry = entry;
+    return quad;
 }
 
-struct OutlineState {
-    std::vector<std::vector<glm::vec2>> lines;
-    float ascender, descender, bearing_x;
-};
+// Lines between the pixels of the hinted size over the unit square, relative to the glyph origin
+std::vector<glm::vec2> pixel_grid(const GlyphCache& cache, glm::vec2 glyph_offset) {
+    std::vector<glm::vec2> ends;
+    float pixel = (float)cache.face()->units_per_EM / (float)cache.pixelSize() / cache.height();
+    glm::vec2 min = -glyph_offset, max = glm::vec2(1, 1) - glyph_offset;
+    for (float x = std::ceil(min.x / pixel) * pixel; x <= max.x; x += pixel) {
+        ends.push_back(glm::vec2(x, min.y));
+        ends.push_back(glm::vec2(x, max.y));
+    }
+    for (float y = std::ceil(min.y / pixel) * pixel; y <= max.y; y += pixel) {
+        ends.push_back(glm::vec2(min.x, y));
+        ends.push_back(glm::vec2(max.x, y));
+    }
+    return ends;
+}
 
-int move_to(const FT_Vector* to, void* user) {
-    OutlineState* state = static_cast<OutlineState*>(user);
-    state->lines.push_back(std::vector<glm::vec2>());
-    state->lines.back().push_back(glm::vec2(to->x - state->bearing_x, to->y - state->descender) / (state->ascender - state->descender));
-    return 0;
+// Changes the size of the hinted outline, sizes already seen are served from the cache
+void set_hinted_size(Context& ctx, GLFWwindow* window, unsigned int pixel_size) {
+    ctx.hinted_cache.setPixelSize(pixel_size);
+    char title[64];
+    if (pixel_size != 0) {
+        std::snprintf(title, sizeof(title), "Font viewer - hinted at %u px", pixel_size);
+    } else {
+        std::snprintf(title, sizeof(title), "Font viewer");
+    }
+    glfwSetWindowTitle(window, title);
 }
 
-int line_to(const FT_Vector* to, void* user) {
-    OutlineState* state = static_cast<OutlineState*>(user);
-    state->lines.back().push_back(glm::vec2(to->x - state->bearing_x, to->y - state->descender) / (state->ascender - state->descender));
-    return 0;
+// Lays out the text and scales it to fit the window
+void update_text(Context& ctx) {
+    TextLayout& layout = ctx.layout;
+    layout_text(ctx.glyph_cache, ctx.text.data(), ctx.text.data() + ctx.text.size(), layout);
+
+    float scale = 0.9f / std::max(layout.width, layout.height);
+    ctx.view_scale = glm::vec2(scale, scale);
+    ctx.view_offset = glm::vec2((1.f - layout.width*scale) / 2.f, (1.f + layout.height*scale) / 2.f);
 }
 
-int conic_to(const FT_Vector* control, const FT_Vector* to, void* user) {
-    OutlineState* state = static_cast<OutlineState*>(user);
-    glm::vec2 w0 = state->lines.back().back() * (state->ascender - state->descender) + glm::vec2(state->bearing_x, state->descender);
-    glm::vec2 w1 = glm::vec2(control->x, control->y);
-    glm::vec2 w2 = glm::vec2(to->x, to->y);
+// Trims the caches while memory is over budget
+void enforce_budget(Context& ctx) {
+    if (!memory_usage.overBudget()) return;
+
+    bool released = ctx.glyph_cache.trim();
+    released |= ctx.hinted_cache.trim();
+    for (ComparedFace& compared : ctx.compared) {
+        released |= compared.glyph_cache->trim();
+    }
+    if (!released && !ctx.budget_exceeded) {
+        ctx.budget_exceeded = true;
+        std::cerr << "Over the memory budget with nothing left to release, the glyphs in use need more" << std::endl;
+        memory_usage.report(std::cerr);
+    }
+}
 
-    unsigned int N = 30;
-    for (unsigned int i = 0; i < N; i++) {
-        float t = (float)i / (float)(N-1);
-        float mt = 1.f - t;
-        glm::vec2 p = mt * mt * w0 + 2 * t * mt * w1 + t * t * w2;
-        p.x -= state->bearing_x;
-        p.y -= state->descender;
-        state->lines.back().push_back(p / (state->ascender - state->descender));
+void report_simplification(const GlyphCache& cache) {
+    if (cache.flattenedPoints() == 0) return;
+    if (cache.removedPoints() > 0) {
+        std::cout << "Simplification removed " << cache.removedPoints() << " of " << cache.flattenedPoints() << " points ("
+                  << 100.0 * (double)cache.removedPoints() / (double)cache.flattenedPoints() << "%)" << std::endl;
     }
+    // the vertices that would be stored without sharing
+    size_t unshared = cache.storedVertices() + cache.sharedPoints();
+    std::cout << "Shared segment ends saved " << cache.sharedPoints() << " of " << unshared << " vertices ("
+              << 100.0 * (double)cache.sharedPoints() / (double)unshared << "%)" << std::endl;
+}
 
-    return 0;
+// View of the mode with the zoom and pan applied
+void zoomed_view(const Context& ctx, glm::vec2& scale, glm::vec2& offset) {
+    glm::vec2 center(0.5f, 0.5f);
+    scale = ctx.view_scale * ctx.zoom;
+    offset = (ctx.view_offset - center) * ctx.zoom + center + ctx.pan;
 }
 
-int cubic_to(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user) {
-    OutlineState* state = static_cast<OutlineState*>(user);
-    glm::vec2 w0 = state->lines.back().back() * (state->ascender - state->descender) + glm::vec2(state->bearing_x, state->descender);
-    glm::vec2 w1 = glm::vec2(control1->x, control1->y);
-    glm::vec2 w2 = glm::vec2(control2->x, control2->y);
-    glm::vec2 w3 = glm::vec2(to->x, to->y);
+// Applies the zoom and pan to the view of the mode and selects the level of
+// detail whose flattening error stays below lod_pixel_tolerance on screen
+void apply_view(Context& ctx, GLFWwindow* window) {
+    glm::vec2 scale, offset;
+    zoomed_view(ctx, scale, offset);
+    ctx.renderer.setView(scale, offset);
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    float pixels_per_unit = scale.x * (float)std::max(width, height);
+    ctx.glyph_cache.setLevel(lod_level_for(lod_pixel_tolerance / pixels_per_unit));
+}
+
+// Cursor position in the [0, 1] window square, y going up
+glm::vec2 cursor_position(GLFWwindow* window) {
+    double x, y;
+    int width, height;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    return glm::vec2((float)x / (float)width, 1.f - (float)y / (float)height);
+}
 
-    const unsigned int N = 30;
-    for (unsigned int i = 0; i < N; i++) {
-        float t = (float)i / (float)(N-1);
-        float mt = 1.f - t;
+// Zooms by factor keeping the point under the cursor in place
+void zoom_view(Context& ctx, glm::vec2 cursor, float factor) {
+    glm::vec2 center(0.5f, 0.5f);
+    glm::vec2 p = (cursor - center - ctx.pan) / ctx.zoom;
+    ctx.zoom *= factor;
+    ctx.pan = cursor - center - p * ctx.zoom;
+}
 
-        glm::vec2 p = mt*mt*mt*w0 + 3.f*t*mt*mt*w1 + 3.f*t*t*mt*w2 + t*t*t*w3;
-        p.x -= state->bearing_x;
-        p.y -= state->descender;
-        state->lines.back().push_back(p / (state->ascender - state->descender));
+void character_callback(GLFWwindow* window, unsigned int codepoint) {
+    Context* ctx = static_cast<Context*>(glfwGetWindowUserPointer(window));
+    if (ctx->mode == Mode::Text) {
+        encode_utf8(codepoint, ctx->text);
+        update_text(*ctx);
+    } else if (ctx->mode == Mode::Glyph) {
+        load_character(*ctx, codepoint);
     }
+}
 
-    return 0;
+// Picks the control point or segment under the cursor and shows it in the window title
+void update_hover(Context& ctx, GLFWwindow* window, glm::vec2 glyph_offset) {
+    glm::vec2 scale, offset;
+    zoomed_view(ctx, scale, offset);
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+
+    glm::vec2 p = (cursor_position(window) - offset) / scale - glyph_offset;
+    OutlinePick pick = ctx.outline_index.pick(p, pick_radius / ((float)width * scale.x));
+    if (pick.kind == ctx.hovered.kind && pick.index == ctx.hovered.index) return;
+    ctx.hovered = pick;
+
+    // positions are shown in font units
+    float units = ctx.glyph_cache.height();
+    char title[128];
+    switch (pick.kind) {
+    case OutlinePick::OnCurve:
+    case OutlinePick::OffCurve:
+        std::snprintf(title, sizeof(title), "Font viewer - %s point %zu (%g, %g)", pick.kind == OutlinePick::OnCurve ? "on-curve" : "off-curve",
+                      pick.index, std::round(pick.a.x * units), std::round(pick.a.y * units));
+        break;
+    case OutlinePick::Segment:
+        std::snprintf(title, sizeof(title), "Font viewer - segment %zu (%g, %g) to (%g, %g)", pick.index,
+                      std::round(pick.a.x * units), std::round(pick.a.y * units), std::round(pick.b.x * units), std::round(pick.b.y * units));
+        break;
+    case OutlinePick::None:
+        std::snprintf(title, sizeof(title), "Font viewer");
+        break;
+    }
+    glfwSetWindowTitle(window, title);
 }
 
-struct Context {
-    LineRenderer& renderer;
-    FT_Face& face;
-    std::vector<LineStrip>& strips;
-};
+// Shows the instance once all the glyphs on screen are flattened for it
+void switch_instance(Context& ctx, GLFWwindow* window, const std::vector<FT_Fixed>& coords) {
+    ctx.glyph_cache.setInstance(coords);
+    ctx.hinted_cache.setInstance(coords);
+    ctx.atlas.clear();
 
-void load_character(std::vector<LineStrip>& strips, FT_Face& face, LineRenderer& renderer, unsigned int codepoint) {
+    // advances and kerning change with the instance
+    if (ctx.mode == Mode::Text) {
+        update_text(ctx);
+    } else if (ctx.mode == Mode::Stream) {
+        ctx.stream_view->invalidate();
+    } else {
+        load_control_points(ctx);
+    }
 
-    strips.clear();
-    unsigned int glyph_index = FT_Get_Char_Index(face, codepoint);
+    std::string title = "Font viewer - " + ctx.sliders->describe();
+    glfwSetWindowTitle(window, title.c_str());
+}
 
-    FT_Error err = FT_Load_Glyph(face, glyph_index, FT_LOAD_NO_SCALE);
-    if (err) {
-        std::cerr << "Failed to load glyph" << std::endl;
-        std::exit(1);
+// Switches right away to a cached instance, flattens the others in the background
+void request_instance(Context& ctx, GLFWwindow* window) {
+    std::vector<FT_Fixed> coords = ctx.sliders->coords();
+    if (ctx.gpu_variations) {
+        std::vector<float> normalized = normalized_coords(ctx.face, coords);
+        normalized.resize(max_delta_axes, 0.f);
+        ctx.axis_coords = glm::vec4(normalized[0], normalized[1], normalized[2], normalized[3]);
+        // the backdrop and control points are loaded on the CPU, only once the slider is let go
+        if (!ctx.sliders->dragging()) {
+            load_gpu_instance(ctx);
+        }
+
+        std::string title = "Font viewer - " + ctx.sliders->describe();
+        glfwSetWindowTitle(window, title.c_str());
+    } else if (ctx.glyph_cache.hasInstance(coords)) {
+        switch_instance(ctx, window, coords);
+    } else {
+        ctx.instance_worker->request(coords, ctx.glyph_cache.glyphIndices());
     }
+}
 
-    assert(face->glyph->format == FT_GLYPH_FORMAT_OUTLINE);
+void stream_key(TextStreamView& view, int key) {
+    switch (key) {
+    case GLFW_KEY_UP:
+        view.scroll(-1);
+        break;
+    case GLFW_KEY_DOWN:
+        view.scroll(1);
+        break;
+    case GLFW_KEY_PAGE_UP:
+        view.scroll(-(float)view.visibleLines());
+        break;
+    case GLFW_KEY_PAGE_DOWN:
+        view.scroll((float)view.visibleLines());
+        break;
+    case GLFW_KEY_HOME:
+        view.scrollTo(0);
+        break;
+    case GLFW_KEY_END:
+        view.scrollToEnd();
+        break;
+    }
+}
 
-    FT_Outline_Funcs outline_funcs;
-    outline_funcs.move_to = move_to;
-    outline_funcs.line_to = line_to;
-    outline_funcs.conic_to = conic_to;
-    outline_funcs.cubic_to = cubic_to;
-    outline_funcs.shift = 0;
-    outline_funcs.delta = 0;
+void scroll_callback(GLFWwindow* window, double, double yoffset) {
+    Context* ctx = static_cast<Context*>(glfwGetWindowUserPointer(window));
+    bool control = glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS;
 
-    OutlineState st;
-    st.ascender = face->ascender;
-    st.descender = face->descender;
-    st.bearing_x = face->glyph->metrics.horiBearingX;
+    // the wheel scrolls through the file in stream mode, Ctrl switches it to zooming
+    if (ctx->mode == Mode::Stream && !control) {
+        ctx->stream_view->scroll(-3.f * (float)yoffset);
+    } else {
+        zoom_view(*ctx, cursor_position(window), std::pow(zoom_step, (float)yoffset));
+    }
+}
 
-    FT_Outline_Decompose(&face->glyph->outline, &outline_funcs, &st);
-    glClearColor(1, 1, 1, 1);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int) {
+    Context* ctx = static_cast<Context*>(glfwGetWindowUserPointer(window));
+    if (button == GLFW_MOUSE_BUTTON_LEFT) {
+        glm::vec2 position = cursor_position(window);
+        if (ctx->sliders && action == GLFW_PRESS && ctx->sliders->press(position)) {
+            request_instance(*ctx, window);
+            return;
+        }
+        if (ctx->sliders && action == GLFW_RELEASE) {
+            bool dragged = ctx->sliders->dragging();
+            ctx->sliders->release();
+            if (dragged && ctx->gpu_variations) {
+                load_gpu_instance(*ctx);
+            }
+        }
+        ctx->dragging = action == GLFW_PRESS;
+        ctx->drag_position = position;
+    } else if (button == GLFW_MOUSE_BUTTON_MIDDLE && action == GLFW_PRESS) {
+        ctx->zoom = 1.f;
+        ctx->pan = glm::vec2(0, 0);
+    }
+}
 
-    for (const auto& line: st.lines) {
-        LineStrip strip = renderer.createLineStrip(line.data(), line.size());
-        strips.push_back(strip);
+void cursor_callback(GLFWwindow* window, double, double) {
+    Context* ctx = static_cast<Context*>(glfwGetWindowUserPointer(window));
+    if (ctx->sliders && ctx->sliders->dragging()) {
+        if (ctx->sliders->drag(cursor_position(window))) {
+            request_instance(*ctx, window);
+        }
+        return;
     }
+    if (!ctx->dragging) return;
+
+    glm::vec2 position = cursor_position(window);
+    ctx->pan += position - ctx->drag_position;
+    ctx->drag_position = position;
 }
 
-void character_callback(GLFWwindow* window, unsigned int codepoint) {
+void key_callback(GLFWwindow* window, int key, int, int action, int mods) {
     Context* ctx = static_cast<Context*>(glfwGetWindowUserPointer(window));
-    load_character(ctx->strips, ctx->face, ctx->renderer, codepoint);
+    if (action == GLFW_RELEASE) return;
+
+    if (key == GLFW_KEY_M && (mods & GLFW_MOD_CONTROL)) {
+        memory_usage.report(std::cout);
+        return;
+    }
+
+    if (ctx->mode == Mode::Stream) {
+        stream_key(*ctx->stream_view, key);
+        return;
+    }
+    if (ctx->mode == Mode::Glyph && key == GLFW_KEY_TAB) {
+        ctx->show_control_points = !ctx->show_control_points;
+        return;
+    }
+    if (ctx->mode == Mode::Glyph && (key == GLFW_KEY_UP || key == GLFW_KEY_DOWN)) {
+        // steps the hinted size by one pixel, going below the smallest size hides the hinted outline
+        unsigned int size = ctx->hinted_cache.pixelSize();
+        if (key == GLFW_KEY_UP) {
+            size = size == 0 ? min_hinted_size : std::min(size + 1, max_hinted_size);
+        } else {
+            size = size <= min_hinted_size ? 0 : size - 1;
+        }
+        set_hinted_size(*ctx, window, size);
+        return;
+    }
+    if (ctx->mode == Mode::Glyph && (key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT)) {
+        // steps through the codepoints of the font, skipping the missing ones
+        uint32_t codepoint;
+        bool found = key == GLFW_KEY_RIGHT ? ctx->coverage.next(ctx->codepoint, codepoint) : ctx->coverage.previous(ctx->codepoint, codepoint);
+        if (found) {
+            load_character(*ctx, codepoint);
+        }
+        return;
+    }
+    if (ctx->mode != Mode::Text) return;
+
+    if (key == GLFW_KEY_BACKSPACE) {
+        pop_utf8(ctx->text);
+        update_text(*ctx);
+    } else if (key == GLFW_KEY_ENTER) {
+        ctx->text += '\n';
+        update_text(*ctx);
+    }
 }
 
 int main(int argc, char** argv)
 {
+    auto start_time = std::chrono::steady_clock::now();
+
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <font file>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " (<font file> | --font <name>)... [--text <string> | --file <text file> | --proof <output dir> [--glyphs <first>[-<last>]]] [--no-cache] [--simplify] [--gpu-variations] [--hinting <pixels>] [--line-width <pixels>] [--memory-budget <MiB>] [--memory-report]" << std::endl;
+        std::cerr << "       " << argv[0] << " --scan <font directory>" << std::endl;
+        std::cerr << "       " << argv[0] << " --covers <string>" << std::endl;
+        std::cerr << "       " << argv[0] << " <font file> --export <file.svg | file.bin> [--glyphs <first>[-<last>]] [--flattened] [--simplify]" << std::endl;
         std::exit(1);
     }
 
-    if (!glfwInit()) {
-        std::cerr << "Failed to init GLFW" << std::endl;
-        std::exit(1);
+    Mode mode = Mode::Glyph;
+    std::string text;
+    const char* text_path = nullptr;
+    bool use_disk_cache = true;
+    bool simplify = false;
+    bool gpu_variations = false;
+    unsigned int hinted_size = 0;
+    float line_width = default_line_width;
+    size_t memory_budget = 0;
+    bool memory_report = false;
+    std::vector<FontSource> font_sources;
+    const char* scan_dir = nullptr;
+    const char* covered_text = nullptr;
+    const char* export_path = nullptr;
+    bool export_flattened_outlines = false;
+    FontIndex font_index;
+    bool index_opened = false;
+    ProofOptions proof_options{.output_dir = "", .first_glyph = 0, .last_glyph = ~0u, .tile_size = proof_tile_size};
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--text") && i + 1 < argc) {
+            mode = Mode::Text;
+            text = argv[++i];
+        } else if (!std::strcmp(argv[i], "--file") && i + 1 < argc) {
+            mode = Mode::Stream;
+            text_path = argv[++i];
+        } else if (!std::strcmp(argv[i], "--proof") && i + 1 < argc) {
+            mode = Mode::Proof;
+            proof_options.output_dir = argv[++i];
+        } else if (!std::strcmp(argv[i], "--glyphs") && i + 1 < argc) {
+            int n = std::sscanf(argv[++i], "%u-%u", &proof_options.first_glyph, &proof_options.last_glyph);
+            if (n < 1) {
+                std::cerr << "Invalid glyph range: " << argv[i] << std::endl;
+                std::exit(1);
+            }
+            if (n == 1) {
+                proof_options.last_glyph = proof_options.first_glyph;
+            }
+        } else if (!std::strcmp(argv[i], "--no-cache")) {
+            use_disk_cache = false;
+        } else if (!std::strcmp(argv[i], "--simplify")) {
+            simplify = true;
+        } else if (!std::strcmp(argv[i], "--gpu-variations")) {
+            gpu_variations = true;
+        } else if (!std::strcmp(argv[i], "--hinting") && i + 1 < argc) {
+            hinted_size = (unsigned int)std::atoi(argv[++i]);
+            if (hinted_size < min_hinted_size || hinted_size > max_hinted_size) {
+                std::cerr << "The hinted size must be between " << min_hinted_size << " and " << max_hinted_size << " pixels" << std::endl;
+                std::exit(1);
+            }
+        } else if (!std::strcmp(argv[i], "--line-width") && i + 1 < argc) {
+            line_width = (float)std::atof(argv[++i]);
+            if (!(line_width >= 0 && line_width <= max_line_width)) {
+                std::cerr << "The line width must be between 0 and " << max_line_width << " pixels" << std::endl;
+                std::exit(1);
+            }
+        } else if (!std::strcmp(argv[i], "--memory-budget") && i + 1 < argc) {
+            int mib = std::atoi(argv[++i]);
+            if (mib <= 0) {
+                std::cerr << "Invalid memory budget: " << argv[i] << std::endl;
+                std::exit(1);
+            }
+            memory_budget = (size_t)mib * 1024 * 1024;
+        } else if (!std::strcmp(argv[i], "--memory-report")) {
+            memory_report = true;
+        } else if (!std::strcmp(argv[i], "--export") && i + 1 < argc) {
+            export_path = argv[++i];
+        } else if (!std::strcmp(argv[i], "--flattened")) {
+            export_flattened_outlines = true;
+        } else if (!std::strcmp(argv[i], "--scan") && i + 1 < argc) {
+            scan_dir = argv[++i];
+        } else if (!std::strcmp(argv[i], "--covers") && i + 1 < argc) {
+            covered_text = argv[++i];
+        } else if (!std::strcmp(argv[i], "--font") && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (!index_opened && !font_index.open(font_index_path())) {
+                std::cerr << "No font index, build it with --scan <font directory>" << std::endl;
+                std::exit(1);
+            }
+            index_opened = true;
+            const IndexedFace* indexed = font_index.find(name);
+            if (!indexed) {
+                std::cerr << "No font named " << name << " in the index" << std::endl;
+                std::exit(1);
+            }
+            font_sources.push_back(FontSource{font_index.string(indexed->path), (long)indexed->face_index});
+        } else if (std::strncmp(argv[i], "--", 2)) {
+            font_sources.push_back(FontSource{argv[i], -1});
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            std::exit(1);
+        }
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-
-    GLFWwindow* window = glfwCreateWindow(600, 600, "Font viewer", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create window" << std::endl;
-        std::exit(1);
+    if (scan_dir) {
+        std::string index_path = font_index_path();
+        if (index_path.empty()) {
+            std::cerr << "No cache directory for the font index" << std::endl;
+            std::exit(1);
+        }
+        ScanStats stats;
+        if (!scan_font_directory(scan_dir, index_path, std::thread::hardware_concurrency(), stats)) {
+            std::exit(1);
+        }
+        std::cout << "Indexed " << stats.n_faces << " faces from " << stats.n_files << " files (" << stats.n_unchanged
+                  << " unchanged), kept " << stats.n_kept << " faces of other directories, in " << elapsed_ms(start_time)
+                  << " ms" << std::endl;
+        return 0;
     }
 
-    glfwSetCharCallback(window, character_callback);
-    glfwMakeContextCurrent(window);
+    if (covered_text) {
+        if (!index_opened && !font_index.open(font_index_path())) {
+            std::cerr << "No font index, build it with --scan <font directory>" << std::endl;
+            std::exit(1);
+        }
+
+        std::vector<uint32_t> codepoints;
+        const char* end = covered_text + std::strlen(covered_text);
+        for (const char* it = covered_text; it != end;) {
+            codepoints.push_back(decode_utf8(it, end));
+        }
+        std::sort(codepoints.begin(), codepoints.end());
+        codepoints.erase(std::unique(codepoints.begin(), codepoints.end()), codepoints.end());
+
+        auto query_start = std::chrono::steady_clock::now();
+        size_t n_matches = 0;
+        for (size_t i = 0; i < font_index.size(); i++) {
+            const IndexedFace& indexed = font_index.face(i);
+            if (!font_index.covers(indexed, codepoints)) continue;
+            std::cout << font_index.string(indexed.family) << " " << font_index.string(indexed.style) << " ("
+                      << font_index.string(indexed.path) << ", face " << indexed.face_index << ")" << std::endl;
+            n_matches++;
+        }
+        std::cout << n_matches << " of " << font_index.size() << " faces cover the text, found in "
+                  << elapsed_ms(query_start) << " ms" << std::endl;
+        return 0;
+    }
 
-    if (!gladLoadGL(glfwGetProcAddress)) {
-        std::cerr << "Failed to initialize OpenGL" << std::endl;
+    if (font_sources.empty()) {
+        std::cerr << "No font file given" << std::endl;
         std::exit(1);
     }
 
-    glEnable(GL_BLEND);
-    glEnable(GL_LINE_SMOOTH);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-    glLineWidth(2.0);
+    if (export_path) {
+        // exports only need FreeType, each worker opening the face on the same mapping
+        const FontSource& source = font_sources[0];
+        MappedFile font;
+        if (!font.open(source.path.c_str())) {
+            std::cerr << "Failed to load the font " << source.path << std::endl;
+            std::exit(1);
+        }
+        std::string path = export_path;
+        bool svg = path.size() >= 4 && path.compare(path.size() - 4, 4, ".svg") == 0;
+        ExportOptions options{.output_path = path, .format = svg ? ExportFormat::Svg : ExportFormat::Binary,
+                              .flattened = export_flattened_outlines, .simplify = simplify,
+                              .first_glyph = proof_options.first_glyph, .last_glyph = proof_options.last_glyph,
+                              .n_threads = std::thread::hardware_concurrency()};
+        ExportStats stats;
+        if (!export_outlines(font, source.face_index < 0 ? 0 : (unsigned int)source.face_index, options, stats)) {
+            std::exit(1);
+        }
+        std::cout << "Exported " << stats.n_glyphs - stats.n_skipped << " glyphs (" << stats.n_skipped << " without outlines), "
+                  << stats.bytes << " bytes in " << elapsed_ms(start_time) << " ms" << std::endl;
+        return 0;
+    }
 
-    LineRenderer renderer;
+    GLFWwindow* window = nullptr;
+    if (mode == Mode::Proof) {
+        if (!init_offscreen_gl()) {
+            std::exit(1);
+        }
+    } else {
+        if (!glfwInit()) {
+            std::cerr << "Failed to init GLFW" << std::endl;
+            std::exit(1);
+        }
 
-    FT_Library ft_lib;
-    FT_Error err = FT_Init_FreeType(&ft_lib);
-    if (err) {
-        std::cerr << "Failed to init FreeType" << std::endl;
-        std::exit(1);
-    }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
-    FT_Face face;
-    err = FT_New_Face(ft_lib, argv[1], 0, &face);
-    if (err) {
-        std::cerr << "Failed to load the font" << std::endl;
-        std::exit(1);
+        window = glfwCreateWindow(window_size, window_size, "Font viewer", nullptr, nullptr);
+        if (!window) {
+            std::cerr << "Failed to create window" << std::endl;
+            std::exit(1);
+        }
+
+        glfwSetCharCallback(window, character_callback);
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetCursorPosCallback(window, cursor_callback);
+        glfwMakeContextCurrent(window);
+
+        if (!gladLoadGL(glfwGetProcAddress)) {
+            std::cerr << "Failed to initialize OpenGL" << std::endl;
+            std::exit(1);
+        }
+        load_gl_extensions(glfwGetProcAddress);
     }
 
-    assert(FT_IS_SCALABLE(face));
+    // the GL objects are destroyed at the end of this block, before their context
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glClearColor(1, 1, 1, 1);
+
+        auto shader_start = std::chrono::steady_clock::now();
+        ProgramCache programs(use_disk_cache);
+        LineRenderer renderer(programs);
+        renderer.setLineWidth(line_width);
+        memory_usage.setBudget(memory_budget);
+        std::cout << "Shader programs ready in " << elapsed_ms(shader_start) << " ms ("
+                  << programs.hits() << " cached, " << programs.misses() << " compiled)" << std::endl;
+
+        FT_Library ft_lib;
+        FT_Error err = FT_Init_FreeType(&ft_lib);
+        if (err) {
+            std::cerr << "Failed to init FreeType" << std::endl;
+            std::exit(1);
+        }
+
+        FontSet fonts(ft_lib);
+        for (const FontSource& source : font_sources) {
+            if (!fonts.open(source.path.c_str(), source.face_index)) {
+                std::cerr << "Failed to load the font " << source.path << std::endl;
+                std::exit(1);
+            }
+        }
+
+        // the first face drives every mode, the others are compared with it in glyph mode
+        const FontFace& main_face = fonts[0];
+        FT_Face face = main_face.face;
+        if (!FT_IS_SCALABLE(face) && !FT_HAS_FIXED_SIZES(face)) {
+            std::cerr << "The font has neither outlines nor bitmaps" << std::endl;
+            std::exit(1);
+        }
+
+        std::cout << "Name: " << face->family_name << " " << face->style_name << std::endl;
+
+        if (FT_IS_SCALABLE(face)) {
+            err = FT_Set_Pixel_Sizes(face, 0, raster_size);
+        } else {
+            // bitmap only fonts are shown at their strike closest to the raster size
+            int strike = 0;
+            for (int i = 1; i < face->num_fixed_sizes; i++) {
+                if (std::abs(face->available_sizes[i].height - raster_size) < std::abs(face->available_sizes[strike].height - raster_size)) {
+                    strike = i;
+                }
+            }
+            err = FT_Select_Size(face, strike);
+        }
+        if (err) {
+            std::cerr << "Failed to set the raster size" << std::endl;
+            std::exit(1);
+        }
+
+        GlyphAtlas atlas(1024, 1024);
+        GlyphAtlas color_atlas(1024, 1024, 4);
+        GlyphDiskCache disk_cache;
+        float flattening = flattening_tolerance(base_tolerance, simplify);
+        if (use_disk_cache && !disk_cache.open(*main_face.file, main_face.index, flattening, base_tolerance - flattening)) {
+            std::cerr << "Glyph disk cache unavailable" << std::endl;
+            use_disk_cache = false;
+        }
+        // proofs are always rendered at the base level of detail
+        LodWorker lod_worker;
+        bool use_lod = mode != Mode::Proof && lod_worker.open(*main_face.file, main_face.index);
+        GlyphArena arena;
+        GlyphCache glyph_cache(arena, face, use_disk_cache ? &disk_cache : nullptr, use_lod ? &lod_worker : nullptr);
+        glyph_cache.setSimplify(simplify);
+        // simplifying would move the points that hinting snapped to the grid
+        GlyphCache hinted_cache(arena, face);
+        hinted_cache.setPixelSize(hinted_size);
+
+        std::vector<VariationAxis> axes = variation_axes(face);
+        std::unique_ptr<AxisSliders> sliders;
+        InstanceWorker instance_worker;
+        if (gpu_variations && (mode != Mode::Glyph || axes.empty())) {
+            std::cerr << "GPU variations only apply to variable fonts in glyph mode" << std::endl;
+            gpu_variations = false;
+        }
+        if (gpu_variations && axes.size() > max_delta_axes) {
+            std::cerr << "Only the first " << max_delta_axes << " axes are interpolated on the GPU" << std::endl;
+        }
+        if (mode != Mode::Proof && !axes.empty()) {
+            if (instance_worker.open(*main_face.file, main_face.index, simplify)) {
+                sliders = std::make_unique<AxisSliders>(axes);
+            } else {
+                std::cerr << "Failed to start the variation worker" << std::endl;
+            }
+        }
+
+        std::vector<ComparedFace> compared;
+        for (size_t i = 1; i < fonts.size(); i++) {
+            if (mode != Mode::Glyph) {
+                std::cerr << "Only the first face is used outside of glyph mode" << std::endl;
+                break;
+            }
+            if (!FT_IS_SCALABLE(fonts[i].face)) {
+                std::cerr << "Skipping " << fonts[i].path << " face " << fonts[i].index << ", it has no outlines" << std::endl;
+                continue;
+            }
+            std::cout << "Comparing with: " << fonts[i].face->family_name << " " << fonts[i].face->style_name << std::endl;
+            compared.push_back(ComparedFace{fonts[i].face, std::make_unique<GlyphCache>(arena, fonts[i].face), 0});
+            compared.back().glyph_cache->setSimplify(simplify);
+        }
+
+        if (mode == Mode::Proof) {
+            unsigned int last_glyph = (unsigned int)face->num_glyphs - 1;
+            proof_options.last_glyph = std::min(proof_options.last_glyph, last_glyph);
+            if (proof_options.first_glyph > proof_options.last_glyph) {
+                std::cerr << "The font only has " << face->num_glyphs << " glyphs" << std::endl;
+                std::exit(1);
+            }
+            render_proofs(renderer, glyph_cache, proof_options);
+        } else {
+            auto coverage_start = std::chrono::steady_clock::now();
+            Coverage coverage(face);
+            std::cout << "Coverage: " << coverage.count() << " codepoints in " << coverage.blocks().size() << " blocks, built in "
+                      << elapsed_ms(coverage_start) << " ms" << std::endl;
+
+            Context ctx{.renderer = renderer, .face = face, .coverage = coverage, .atlas = atlas, .color_atlas = color_atlas,
+                        .codepoint = 0, .glyph_index = 0, .color_layers = {}, .bitmap_glyph = false, .show_control_points = true,
+                        .outline_index = OutlineIndex(), .hovered = OutlinePick(),
+                        .glyph_cache = glyph_cache, .hinted_cache = hinted_cache, .mode = mode, .text = text, .layout = TextLayout(), .stream_view = nullptr,
+                        .view_scale = glm::vec2(1, 1), .view_offset = glm::vec2(0, 0), .zoom = 1.f, .pan = glm::vec2(0, 0),
+                        .dragging = false, .drag_position = glm::vec2(0, 0),
+                        .sliders = sliders.get(), .instance_worker = sliders ? &instance_worker : nullptr, .axes = axes,
+                        .gpu_variations = gpu_variations && sliders, .has_deltas = false, .axis_coords = glm::vec4(0, 0, 0, 0),
+                        .compared = compared};
 
-    std::cout << "Name: " << face->family_name << " " << face->style_name << std::endl;
+            glfwSetWindowUserPointer(window, &ctx);
 
-    std::vector<LineStrip> strips;
-    Context ctx{.renderer = renderer, .face = face, .strips = strips};
+            MappedFile text_file;
+            std::unique_ptr<TextStream> stream;
+            std::unique_ptr<TextStreamView> stream_view;
 
-    glfwSetWindowUserPointer(window, &ctx);
+            if (mode == Mode::Text) {
+                update_text(ctx);
+            } else if (mode == Mode::Stream) {
+                if (!text_file.open(text_path)) {
+                    std::cerr << "Failed to open " << text_path << std::endl;
+                    std::exit(1);
+                }
+                stream = std::make_unique<TextStream>(text_file.data(), text_file.size());
+                stream_view = std::make_unique<TextStreamView>(*stream, glyph_cache, stream_visible_lines, stream_prefetch_lines);
+                ctx.stream_view = stream_view.get();
+            } else {
+                uint32_t first = 'B';
+                if (coverage.count() > 0 && !coverage.contains(first)) {
+                    coverage.next(0, first);
+                }
+                load_character(ctx, first);
+            }
 
-    load_character(strips, face, renderer, 'B');
+            std::vector<AtlasQuad> quads, color_quads;
+            std::vector<GlyphInstance> glyph_instance(1);
+            InstanceResult instance_result;
+            bool first_frame = true;
+            while (!glfwWindowShouldClose(window)) {
+                if (first_frame) {
+                    std::cout << "Startup took " << elapsed_ms(start_time) << " ms" << std::endl;
+                    first_frame = false;
+                }
+                glfwPollEvents();
+                glyph_cache.update();
+                enforce_budget(ctx);
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+                if (sliders && instance_worker.poll(instance_result)) {
+                    for (size_t i = 0; i < instance_result.glyphs.size(); i++) {
+                        glyph_cache.store(instance_result.coords, instance_result.glyph_indices[i], instance_result.glyphs[i]);
+                    }
+                    if (instance_result.coords == sliders->coords()) {
+                        switch_instance(ctx, window, instance_result.coords);
+                    }
+                }
 
-        glClear(GL_COLOR_BUFFER_BIT);
-        for (const LineStrip& strip : strips) {
-            renderer.drawLineStrip(strip);
+                if (mode == Mode::Text) {
+                    apply_view(ctx, window);
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    renderer.drawGlyphInstances(glyph_cache, ctx.layout.instances);
+                } else if (mode == Mode::Stream) {
+                    stream_view->update();
+
+                    float scale = 1.f / stream_view->viewWidth();
+                    float offset_y = 1.f + stream_view->top() * stream_view->lineHeight() * scale;
+                    ctx.view_scale = glm::vec2(scale, scale);
+                    ctx.view_offset = glm::vec2(0.01f, offset_y);
+                    apply_view(ctx, window);
+
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    renderer.drawGlyphInstances(glyph_cache, stream_view->instances());
+                } else {
+                    const GlyphGeometry& glyph = glyph_cache.get(ctx.glyph_index);
+
+                    quads.clear();
+                    color_quads.clear();
+                    if (ctx.bitmap_glyph) {
+                        // the bitmap replaces the gray backdrop, it is inserted once and drawn from the atlas after that
+                        const AtlasEntry* entry = color_atlas.find(ctx.glyph_index);
+                        if (!entry) entry = rasterize_bitmap(color_atlas, face, ctx.glyph_index);
+                        if (entry) {
+                            color_quads.push_back(raster_quad(entry, face, glyph.bearing_x));
+                        }
+                        color_atlas.upload();
+                    } else {
+                        const AtlasEntry* entry = rasterize_glyph(atlas, face, ctx.glyph_index);
+                        if (entry) {
+                            quads.push_back(raster_quad(entry, face, glyph.bearing_x));
+                        }
+                        atlas.upload();
+                    }
+
+                    // the glyph's bounding box starts at the left edge and the descender at the bottom
+                    glm::vec2 glyph_offset(-glyph.bearing_x, -(float)face->descender / glyph_cache.height());
+                    glyph_instance[0] = GlyphInstance{ctx.glyph_index, glyph_offset};
+                    // compared faces are laid out in unit wide columns to the right of the main one
+                    float columns = (float)(1 + compared.size());
+                    ctx.view_scale = glm::vec2(1, 1) / columns;
+                    ctx.view_offset = glm::vec2(0, (1.f - 1.f / columns) / 2.f);
+                    apply_view(ctx, window);
+
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    renderer.drawAtlasQuads(atlas, quads);
+                    renderer.drawAtlasQuads(color_atlas, color_quads);
+                    if (!ctx.color_layers.empty()) {
+                        // layers are outline glyphs of the same face, cached like any other glyph and
+                        // loaded again here since switching instances may leave them out of the cache
+                        for (const ColorLayer& layer : ctx.color_layers) {
+                            glyph_cache.get(layer.glyph_index);
+                            glyph_instance[0] = GlyphInstance{layer.glyph_index, glyph_offset};
+                            renderer.drawGlyphInstances(glyph_cache, glyph_instance, layer.color);
+                        }
+                    } else if (ctx.gpu_variations && ctx.has_deltas) {
+                        renderer.drawDeltaGlyph(glyph_offset, ctx.axis_coords);
+                    } else if (hinted_cache.pixelSize() != 0) {
+                        hinted_cache.get(ctx.glyph_index);
+                        renderer.drawGlyphInstances(glyph_cache, glyph_instance, unhinted_color);
+                        renderer.drawLines(pixel_grid(hinted_cache, glyph_offset), glyph_offset, pixel_grid_color);
+                        renderer.drawGlyphInstances(hinted_cache, glyph_instance);
+                    } else {
+                        renderer.drawGlyphInstances(glyph_cache, glyph_instance);
+                    }
+                    for (size_t i = 0; i < compared.size(); i++) {
+                        const GlyphCache& cache = *compared[i].glyph_cache;
+                        float bearing_x = cache.find(compared[i].glyph_index)->bearing_x;
+                        glm::vec2 offset((float)(i + 1) - bearing_x, -(float)compared[i].face->descender / cache.height());
+                        renderer.drawGlyphInstances(cache, {GlyphInstance{compared[i].glyph_index, offset}});
+                    }
+                    if (ctx.show_control_points) {
+                        update_hover(ctx, window, glyph_offset);
+                        renderer.drawControlPoints(glyph_offset);
+                        if (ctx.hovered.kind == OutlinePick::Segment) {
+                            renderer.drawLines({ctx.hovered.a, ctx.hovered.b}, glyph_offset, highlight_color);
+                        } else if (ctx.hovered.kind != OutlinePick::None) {
+                            renderer.drawMarkers({ctx.hovered.a}, glyph_offset, highlight_marker_size, highlight_color,
+                                                 ctx.hovered.kind == OutlinePick::OffCurve);
+                        }
+                    }
+                }
+
+                if (sliders) {
+                    sliders->draw(renderer);
+                }
+                renderer.submit();
+                glfwSwapBuffers(window);
+            }
+        }
+
+        report_simplification(glyph_cache);
+        if (memory_report) {
+            memory_usage.report(std::cout);
         }
-        glfwSwapBuffers(window);
     }
 
-    glfwTerminate();
+    if (mode == Mode::Proof) {
+        terminate_offscreen_gl();
+    } else {
+        glfwTerminate();
+    }
     return 0;
 }
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path);
+    void close();
+
+    const char* data() const { return static_cast<const char*>(ptr); }
+    size_t size() const { return length; }
+
+private:
+    void* ptr;
+    size_t length;
+};
@@ -0,0 +1,131 @@
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+MemoryUsage memory_usage;
+
+static const char* category_name(MemoryCategory category) {
+    switch (category) {
+    case MemoryCategory::Outlines: return "outlines";
+    case MemoryCategory::GlyphCache: return "glyph cache";
+    case MemoryCategory::TextLayout: return "text layout";
+    case MemoryCategory::Atlas: return "atlas";
+    }
+    return "unknown";
+}
+
+static std::string format_bytes(size_t bytes) {
+    char text[32];
+    if (bytes >= 1024 * 1024) {
+        std::snprintf(text, sizeof(text), "%.2f MiB", (double)bytes / (1024. * 1024.));
+    } else if (bytes >= 1024) {
+        std::snprintf(text, sizeof(text), "%.1f KiB", (double)bytes / 1024.);
+    } else {
+        std::snprintf(text, sizeof(text), "%zu B", bytes);
+    }
+    return text;
+}
+
+MemoryUsage::MemoryUsage(): budget(0) {}
+
+void MemoryUsage::addSource(const void* owner, MemoryCategory category, std::function<size_t()> bytes) {
+    sources[owner] = Source{category, std::move(bytes)};
+}
+
+void MemoryUsage::removeSource(const void* owner) {
+    sources.erase(owner);
+}
+
+void MemoryUsage::setBuffer(unsigned int buffer, const char* label, size_t bytes) {
+    setBuffer(buffer, label, bytes, bytes);
+}
+
+void MemoryUsage::setBuffer(unsigned int buffer, const char* label, size_t bytes, size_t used) {
+    buffers[buffer] = GpuObject{label, bytes, used};
+}
+
+void MemoryUsage::releaseBuffer(unsigned int buffer) {
+    buffers.erase(buffer);
+}
+
+void MemoryUsage::setTexture(unsigned int texture, const char* label, size_t bytes) {
+    textures[texture] = GpuObject{label, bytes, bytes};
+}
+
+void MemoryUsage::releaseTexture(unsigned int texture) {
+    textures.erase(texture);
+}
+
+size_t MemoryUsage::cpuBytes(MemoryCategory category) const {
+    size_t total = 0;
+    for (const auto& source : sources) {
+        if (source.second.category == category) total += source.second.bytes();
+    }
+    return total;
+}
+
+size_t MemoryUsage::cpuBytes() const {
+    size_t total = 0;
+    for (const auto& source : sources) {
+        total += source.second.bytes();
+    }
+    return total;
+}
+
+size_t MemoryUsage::gpuBytes() const {
+    size_t total = 0;
+    for (const auto* objects : {&buffers, &textures}) {
+        for (const auto& object : *objects) {
+            total += object.second.bytes;
+        }
+    }
+    return total;
+}
+
+size_t MemoryUsage::usedBytes() const {
+    size_t total = cpuBytes();
+    for (const auto* objects : {&buffers, &textures}) {
+        for (const auto& object : *objects) {
+            total += object.second.used;
+        }
+    }
+    return total;
+}
+
+void MemoryUsage::report(std::ostream& out) const {
+    out << "Memory: " << format_bytes(cpuBytes()) << " CPU, " << format_bytes(gpuBytes()) << " GPU";
+    if (budget != 0) {
+        out << ", " << format_bytes(usedBytes()) << " counted against a budget of " << format_bytes(budget);
+    }
+    out << std::endl;
+
+    for (int c = 0; c < n_memory_categories; c++) {
+        MemoryCategory category = (MemoryCategory)c;
+        out << "  CPU " << category_name(category) << ": " << format_bytes(cpuBytes(category)) << std::endl;
+    }
+
+    // largest first
+    struct Line {
+        const char* kind;
+        unsigned int name;
+        GpuObject object;
+    };
+    std::vector<Line> lines;
+    for (const auto& buffer : buffers) {
+        lines.push_back(Line{"buffer", buffer.first, buffer.second});
+    }
+    for (const auto& texture : textures) {
+        lines.push_back(Line{"texture", texture.first, texture.second});
+    }
+    std::sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) { return a.object.bytes > b.object.bytes; });
+    for (const Line& line : lines) {
+        out << "  GPU " << line.kind << " " << line.name << " (" << line.object.label << "): " << format_bytes(line.object.bytes);
+        if (line.object.used != line.object.bytes) {
+            out << ", " << format_bytes(line.object.used) << " in use";
+        }
+        out << std::endl;
+    }
+}
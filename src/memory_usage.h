@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+// What the CPU memory of a source holds
+enum class MemoryCategory {
+    Outlines,    // points of the outline being inspected
+    GlyphCache,  // geometry ranges of the cached glyphs and instances
+    TextLayout,  // laid out lines
+    Atlas,       // CPU copies of the atlas pixels
+};
+
+static const int n_memory_categories = 4;
+
+// Heap bytes of a vector or a node based container, estimated from its size and the usual layout
+template <typename T>
+size_t vector_bytes(const std::vector<T>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+template <typename Map>
+size_t map_bytes(const Map& map) {
+    return map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*)) + map.bucket_count() * sizeof(void*);
+}
+
+// Accounting of the memory held by the long lived objects of the viewer.
+// CPU memory is measured from its owners, which register as sources, when a
+// report or the budget needs it. GPU memory is declared per buffer and
+// texture whenever their storage is allocated. Main thread only.
+//
+// With a budget, the caches are trimmed by the caller whenever overBudget
+// returns true. GPU buffers that keep released ranges for reuse, like the
+// glyph arena, count the bytes in use against the budget rather than their
+// allocation, since trimming does not shrink them.
+class MemoryUsage {
+public:
+    MemoryUsage();
+
+    void addSource(const void* owner, MemoryCategory category, std::function<size_t()> bytes);
+    void removeSource(const void* owner);
+
+    // Replaces the size of a buffer or texture, used is the part of it that holds live data
+    void setBuffer(unsigned int buffer, const char* label, size_t bytes);
+    void setBuffer(unsigned int buffer, const char* label, size_t bytes, size_t used);
+    void releaseBuffer(unsigned int buffer);
+    void setTexture(unsigned int texture, const char* label, size_t bytes);
+    void releaseTexture(unsigned int texture);
+
+    size_t cpuBytes(MemoryCategory category) const;
+    size_t cpuBytes() const;
+    size_t gpuBytes() const;
+    // CPU bytes and the GPU bytes in use, what the budget applies to
+    size_t usedBytes() const;
+
+    // 0 for no budget
+    void setBudget(size_t bytes) { budget = bytes; }
+    size_t budgetBytes() const { return budget; }
+    bool overBudget() const { return budget != 0 && usedBytes() > budget; }
+
+    // Prints the totals then the bytes of every category, buffer and texture
+    void report(std::ostream& out) const;
+
+private:
+    struct Source {
+        MemoryCategory category;
+        std::function<size_t()> bytes;
+    };
+
+    struct GpuObject {
+        const char* label;
+        size_t bytes, used;
+    };
+
+    std::unordered_map<const void*, Source> sources;
+    std::unordered_map<unsigned int, GpuObject> buffers, textures;
+    size_t budget;
+};
+
+extern MemoryUsage memory_usage;
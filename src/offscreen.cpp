@@ -0,0 +1,92 @@
+#include "offscreen.h"
+
+// EGL has to come before glad, which defines its own subset of khrplatform.h
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+#include <iostream>
+
+#include "gl_extensions.h"
+#include "glad.h"
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+
+static EGLDisplay get_display() {
+    auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display) {
+        EGLDisplay surfaceless = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (surfaceless != EGL_NO_DISPLAY) return surfaceless;
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static GLADapiproc load_proc(const char* name) {
+    return reinterpret_cast<GLADapiproc>(eglGetProcAddress(name));
+}
+
+bool init_offscreen_gl() {
+    display = get_display();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        std::cerr << "Failed to initialize EGL" << std::endl;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL does not support desktop OpenGL" << std::endl;
+        return false;
+    }
+
+    // the surfaceless platform may expose no config at all, which is fine without a surface
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions || !std::strstr(extensions, "EGL_KHR_no_config_context")) {
+        const EGLint config_attribs[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE,
+        };
+        EGLint n_configs = 0;
+        if (!eglChooseConfig(display, config_attribs, &config, 1, &n_configs) || n_configs == 0) {
+            std::cerr << "No EGL config supports OpenGL" << std::endl;
+            return false;
+        }
+    }
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "Failed to create an EGL context" << std::endl;
+        return false;
+    }
+
+    // rendering only ever targets framebuffer objects, so no surface is needed
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "Failed to make the EGL context current without a surface" << std::endl;
+        return false;
+    }
+
+    if (!gladLoadGL(load_proc)) {
+        std::cerr << "Failed to initialize OpenGL" << std::endl;
+        return false;
+    }
+    load_gl_extensions(load_proc);
+
+    return true;
+}
+
+void terminate_offscreen_gl() {
+    if (display == EGL_NO_DISPLAY) return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) {
+        eglDestroyContext(display, context);
+    }
+    eglTerminate(display);
+    display = EGL_NO_DISPLAY;
+    context = EGL_NO_CONTEXT;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Creates a GL 3.3 core context without any window or display server
+// (EGL on the surfaceless platform, e.g. Mesa llvmpipe on a headless
+// server) and loads the GL entry points. Returns false if unavailable.
+bool init_offscreen_gl();
+void terminate_offscreen_gl();
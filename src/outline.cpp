@@ -0,0 +1,196 @@
+#include "outline.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glm/geometric.hpp"
+
+// Uniform subdivision of a degree d curve into n segments stays within
+// d(d-1)/8 * max|second difference| / n^2 of the curve (Wang's formula)
+static unsigned int curve_segments(const OutlineState* state, float degree_factor, float second_difference) {
+    float tolerance = state->tolerance * state->scale;
+    float n = std::ceil(std::sqrt(degree_factor * second_difference / tolerance));
+    return (unsigned int)std::clamp(n, 1.f, (float)max_curve_segments);
+}
+
+// Reuses the recorded count of the curve if there is one
+static unsigned int split_curve(OutlineState* state, float degree_factor, float second_difference) {
+    if (!state->segment_counts) return curve_segments(state, degree_factor, second_difference);
+
+    std::vector<unsigned int>& counts = *state->segment_counts;
+    if (state->n_curves == counts.size()) {
+        counts.push_back(curve_segments(state, degree_factor, second_difference));
+    }
+    return counts[state->n_curves++];
+}
+
+int move_to(const FT_Vector* to, void* user) {
+    OutlineState* state = static_cast<OutlineState*>(user);
+    state->last = glm::vec2(to->x, to->y);
+    state->lines.push_back(std::vector<glm::vec2>());
+    state->lines.back().push_back((state->last - state->origin) / state->scale);
+    return 0;
+}
+
+int line_to(const FT_Vector* to, void* user) {
+    OutlineState* state = static_cast<OutlineState*>(user);
+    state->last = glm::vec2(to->x, to->y);
+    state->lines.back().push_back((state->last - state->origin) / state->scale);
+    return 0;
+}
+
+int conic_to(const FT_Vector* control, const FT_Vector* to, void* user) {
+    OutlineState* state = static_cast<OutlineState*>(user);
+    glm::vec2 w0 = state->last;
+    glm::vec2 w1 = glm::vec2(control->x, control->y);
+    glm::vec2 w2 = glm::vec2(to->x, to->y);
+
+    // the point at t = 0 is already the last of the contour
+    unsigned int N = split_curve(state, 2.f / 8.f, glm::length(w0 - 2.f*w1 + w2)) + 1;
+    state->n_shared++;
+    for (unsigned int i = 1; i < N; i++) {
+        float t = (float)i / (float)(N-1);
+        float mt = 1.f - t;
+        glm::vec2 p = mt * mt * w0 + 2 * t * mt * w1 + t * t * w2;
+        state->lines.back().push_back((p - state->origin) / state->scale);
+    }
+
+    state->last = w2;
+    return 0;
+}
+
+int cubic_to(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user) {
+    OutlineState* state = static_cast<OutlineState*>(user);
+    glm::vec2 w0 = state->last;
+    glm::vec2 w1 = glm::vec2(control1->x, control1->y);
+    glm::vec2 w2 = glm::vec2(control2->x, control2->y);
+    glm::vec2 w3 = glm::vec2(to->x, to->y);
+
+    float second_difference = std::max(glm::length(w0 - 2.f*w1 + w2), glm::length(w1 - 2.f*w2 + w3));
+    const unsigned int N = split_curve(state, 6.f / 8.f, second_difference) + 1;
+    state->n_shared++;
+    for (unsigned int i = 1; i < N; i++) {
+        float t = (float)i / (float)(N-1);
+        float mt = 1.f - t;
+
+        glm::vec2 p = mt*mt*mt*w0 + 3.f*t*mt*mt*w1 + 3.f*t*t*mt*w2 + t*t*t*w3;
+        state->lines.back().push_back((p - state->origin) / state->scale);
+    }
+
+    state->last = w3;
+    return 0;
+}
+
+void decompose_outline(FT_Outline* outline, OutlineState& st) {
+    FT_Outline_Funcs outline_funcs;
+    outline_funcs.move_to = move_to;
+    outline_funcs.line_to = line_to;
+    outline_funcs.conic_to = conic_to;
+    outline_funcs.cubic_to = cubic_to;
+    outline_funcs.shift = 0;
+    outline_funcs.delta = 0;
+
+    FT_Outline_Decompose(outline, &outline_funcs, &st);
+}
+
+void collect_control_points(const FT_Outline* outline, glm::vec2 origin, float scale, ControlPoints& points) {
+    auto point = [&](int i) { return (glm::vec2(outline->points[i].x, outline->points[i].y) - origin) / scale; };
+
+    int start = 0;
+    for (int c = 0; c < outline->n_contours; c++) {
+        int end = outline->contours[c];
+        for (int i = start; i <= end; i++) {
+            char tag = FT_CURVE_TAG(outline->tags[i]);
+            glm::vec2 p = point(i);
+            if (tag == FT_CURVE_TAG_ON) {
+                points.on_curve.push_back(p);
+                continue;
+            }
+            points.off_curve.push_back(p);
+
+            // handles go to the ends of the curve, which between two conic
+            // control points is the implied midpoint, and not from one cubic
+            // control point to the other
+            for (int n : {i == start ? end : i - 1, i == end ? start : i + 1}) {
+                char neighbour = FT_CURVE_TAG(outline->tags[n]);
+                if (neighbour == FT_CURVE_TAG_ON) {
+                    points.handles.push_back(point(n));
+                    points.handles.push_back(p);
+                } else if (tag == FT_CURVE_TAG_CONIC && neighbour == FT_CURVE_TAG_CONIC) {
+                    points.handles.push_back(0.5f * (point(n) + p));
+                    points.handles.push_back(p);
+                }
+            }
+        }
+        start = end + 1;
+    }
+}
+
+float segment_distance(glm::vec2 p, glm::vec2 a, glm::vec2 b) {
+    glm::vec2 ab = b - a;
+    float length2 = glm::dot(ab, ab);
+    if (length2 == 0.f) return glm::length(p - a);
+
+    float t = std::clamp(glm::dot(p - a, ab) / length2, 0.f, 1.f);
+    return glm::length(p - (a + t * ab));
+}
+
+// Keeps the point of (first, last) furthest from the segment between them if
+// it is further than tolerance, and recurses on both sides of it
+static void simplify_range(const std::vector<glm::vec2>& points, size_t first, size_t last, float tolerance, std::vector<bool>& keep) {
+    if (last <= first + 1) return;
+
+    size_t furthest = first;
+    float max_distance = tolerance;
+    for (size_t i = first + 1; i < last; i++) {
+        float distance = segment_distance(points[i], points[first], points[last]);
+        if (distance > max_distance) {
+            max_distance = distance;
+            furthest = i;
+        }
+    }
+    if (furthest == first) return;
+
+    keep[furthest] = true;
+    simplify_range(points, first, furthest, tolerance, keep);
+    simplify_range(points, furthest, last, tolerance, keep);
+}
+
+size_t simplify_outline(OutlineState& st, float tolerance) {
+    size_t removed = 0;
+    std::vector<bool> keep;
+
+    for (std::vector<glm::vec2>& line : st.lines) {
+        size_t n = line.size();
+        if (n < 3) continue;
+
+        // contours are closed, so they are split at the point furthest from
+        // the start to give both halves a non degenerate baseline
+        size_t split = 0;
+        float max_distance = 0.f;
+        for (size_t i = 1; i < n - 1; i++) {
+            float distance = glm::length(line[i] - line[0]);
+            if (distance > max_distance) {
+                max_distance = distance;
+                split = i;
+            }
+        }
+
+        keep.assign(n, false);
+        keep[0] = keep[n - 1] = true;
+        if (split != 0) {
+            keep[split] = true;
+            simplify_range(line, 0, split, tolerance, keep);
+            simplify_range(line, split, n - 1, tolerance, keep);
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (keep[i]) line[kept++] = line[i];
+        }
+        line.resize(kept);
+        removed += n - kept;
+    }
+
+    return removed;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+#include "glm/vec2.hpp"
+
+// Upper bound on the number of segments a single curve is flattened into
+static const unsigned int max_curve_segments = 256;
+
+// Points of the outline before flattening, in the same units as the flattened contours
+struct ControlPoints {
+    std::vector<glm::vec2> on_curve, off_curve;
+    std::vector<glm::vec2> handles;  // pairs of segment ends joining on-curve and off-curve points
+};
+
+// Flattened contours of a glyph, stored as (p - origin) / scale where p is in font units.
+// Curves are subdivided just enough to stay within tolerance of the flattening,
+// which is expressed in the same units as the stored points.
+struct OutlineState {
+    std::vector<std::vector<glm::vec2>> lines;
+    glm::vec2 origin;
+    float scale;
+    float tolerance;
+    glm::vec2 last;
+    // When set, curves take their segment counts from here in order and the
+    // counts of the curves past the end are appended, so that another
+    // instance of a variable glyph can be flattened into the same vertices
+    std::vector<unsigned int>* segment_counts = nullptr;
+    size_t n_curves = 0;
+    // curve starts left out of the contours, being the end of the previous segment
+    size_t n_shared = 0;
+};
+
+int move_to(const FT_Vector* to, void* user);
+int line_to(const FT_Vector* to, void* user);
+int conic_to(const FT_Vector* control, const FT_Vector* to, void* user);
+int cubic_to(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user);
+
+void decompose_outline(FT_Outline* outline, OutlineState& st);
+// Appends the points of the outline as stored in the font, (p - origin) / scale
+// like the flattened contours. The midpoints implied between two conic control
+// points are not on-curve points of their own, only the ends of handles.
+void collect_control_points(const FT_Outline* outline, glm::vec2 origin, float scale, ControlPoints& points);
+// Distance from p to the segment [a, b]
+float segment_distance(glm::vec2 p, glm::vec2 a, glm::vec2 b);
+
+// Drops the points of each contour that are within tolerance of the simplified
+// contour (Douglas-Peucker), returns the number of points removed
+size_t simplify_outline(OutlineState& st, float tolerance);
@@ -0,0 +1,328 @@
+#include "outline_export.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+#include "glm/vec2.hpp"
+#include "glyph_cache.h"
+#include "glyph_lod.h"
+#include "mapped_file.h"
+
+static const char export_magic[4] = {'F', 'V', 'O', 'X'};
+static const uint32_t export_version = 1;
+static const unsigned int export_chunk_glyphs = 64;
+// chunks encoded ahead of the one being written, per worker
+static const unsigned int export_chunks_ahead = 2;
+static const unsigned int svg_columns = 16;
+
+struct GlyphPath {
+    std::vector<uint8_t> commands;
+    std::vector<glm::vec2> points;
+    float advance;
+};
+
+static int path_move_to(const FT_Vector* to, void* user) {
+    GlyphPath* path = static_cast<GlyphPath*>(user);
+    path->commands.push_back(MoveTo);
+    path->points.push_back(glm::vec2(to->x, to->y));
+    return 0;
+}
+
+static int path_line_to(const FT_Vector* to, void* user) {
+    GlyphPath* path = static_cast<GlyphPath*>(user);
+    path->commands.push_back(LineTo);
+    path->points.push_back(glm::vec2(to->x, to->y));
+    return 0;
+}
+
+static int path_conic_to(const FT_Vector* control, const FT_Vector* to, void* user) {
+    GlyphPath* path = static_cast<GlyphPath*>(user);
+    path->commands.push_back(ConicTo);
+    path->points.push_back(glm::vec2(control->x, control->y));
+    path->points.push_back(glm::vec2(to->x, to->y));
+    return 0;
+}
+
+static int path_cubic_to(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user) {
+    GlyphPath* path = static_cast<GlyphPath*>(user);
+    path->commands.push_back(CubicTo);
+    path->points.push_back(glm::vec2(control1->x, control1->y));
+    path->points.push_back(glm::vec2(control2->x, control2->y));
+    path->points.push_back(glm::vec2(to->x, to->y));
+    return 0;
+}
+
+// Commands of the glyph in font units, either the curves of the outline or its flattened contours
+static GlyphStatus trace_glyph(FT_Face face, unsigned int glyph_index, const ExportOptions& options, GlyphPath& path) {
+    path.commands.clear();
+    path.points.clear();
+    path.advance = 0.f;
+
+    if (options.flattened) {
+        FlattenedGlyph glyph;
+        GlyphStatus status = flatten_glyph(face, glyph_index, base_tolerance, options.simplify, glyph);
+        float height = (float)(face->ascender - face->descender);
+        path.advance = glyph.advance * height;
+        if (status != GlyphStatus::Ok) return status;
+
+        bool contour_start = true;
+        for (unsigned int index : glyph.indices) {
+            if (index == restart_index) {
+                contour_start = true;
+                continue;
+            }
+            path.commands.push_back(contour_start ? MoveTo : LineTo);
+            path.points.push_back(glyph.vertices[index] * height);
+            contour_start = false;
+        }
+        return GlyphStatus::Ok;
+    }
+
+    if (glyph_index >= (unsigned int)face->num_glyphs) return GlyphStatus::InvalidIndex;
+    if (FT_Load_Glyph(face, glyph_index, FT_LOAD_NO_SCALE)) return GlyphStatus::LoadFailed;
+    path.advance = (float)face->glyph->metrics.horiAdvance;
+    if (face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) return GlyphStatus::NotOutline;
+
+    FT_Outline_Funcs funcs;
+    funcs.move_to = path_move_to;
+    funcs.line_to = path_line_to;
+    funcs.conic_to = path_conic_to;
+    funcs.cubic_to = path_cubic_to;
+    funcs.shift = 0;
+    funcs.delta = 0;
+    if (FT_Outline_Decompose(&face->glyph->outline, &funcs, &path)) return GlyphStatus::LoadFailed;
+    return GlyphStatus::Ok;
+}
+
+static void append_bytes(std::string& out, const void* data, size_t size) {
+    out.append(static_cast<const char*>(data), size);
+}
+
+static void append_binary(std::string& out, unsigned int glyph_index, GlyphStatus status, const GlyphPath& path) {
+    ExportGlyph record{glyph_index, (uint32_t)status, path.advance, (uint32_t)path.commands.size(), (uint32_t)path.points.size()};
+    append_bytes(out, &record, sizeof(record));
+    append_bytes(out, path.commands.data(), path.commands.size());
+    out.append((4 - path.commands.size() % 4) % 4, '\0');
+    append_bytes(out, path.points.data(), path.points.size()*sizeof(glm::vec2));
+}
+
+static void append_point(std::string& out, char command, glm::vec2 p) {
+    char text[48];
+    std::snprintf(text, sizeof(text), "%c%g %g", command, p.x, p.y);
+    out += text;
+}
+
+// Glyphs are placed in cells one em wide and one ascender - descender high, flipped so that y goes down
+static void append_svg(std::string& out, FT_Face face, unsigned int glyph_index, unsigned int position, const GlyphPath& path) {
+    char text[128];
+    float x = (float)(position % svg_columns) * (float)face->units_per_EM;
+    float y = (float)(position / svg_columns) * (float)(face->ascender - face->descender) + (float)face->ascender;
+    std::snprintf(text, sizeof(text), "<path id=\"glyph-%05u\" transform=\"translate(%g %g) scale(1 -1)\" d=\"", glyph_index, x, y);
+    out += text;
+
+    const glm::vec2* p = path.points.data();
+    for (size_t i = 0; i < path.commands.size(); i++) {
+        switch (path.commands[i]) {
+        case MoveTo:
+            if (i > 0) out += 'Z';
+            append_point(out, 'M', *p++);
+            break;
+        case LineTo:
+            append_point(out, 'L', *p++);
+            break;
+        case ConicTo:
+            append_point(out, 'Q', *p++);
+            append_point(out, ' ', *p++);
+            break;
+        case CubicTo:
+            append_point(out, 'C', *p++);
+            append_point(out, ' ', *p++);
+            append_point(out, ' ', *p++);
+            break;
+        }
+    }
+    if (!path.commands.empty()) out += 'Z';
+    out += "\"/>\n";
+}
+
+struct EncodedChunk {
+    std::string data;
+    size_t n_glyphs, n_skipped;
+};
+
+bool export_outlines(const MappedFile& font, unsigned int face_index, const ExportOptions& options, ExportStats& stats) {
+    stats = ExportStats{0, 0, 0};
+
+    FT_Library ft_lib;
+    FT_Face face;
+    if (FT_Init_FreeType(&ft_lib)) return false;
+    if (FT_New_Memory_Face(ft_lib, reinterpret_cast<const FT_Byte*>(font.data()), font.size(), face_index, &face)) {
+        std::cerr << "Failed to open the face to export" << std::endl;
+        FT_Done_FreeType(ft_lib);
+        return false;
+    }
+
+    unsigned int first_glyph = options.first_glyph;
+    unsigned int last_glyph = std::min(options.last_glyph, (unsigned int)face->num_glyphs - 1);
+    if (face->num_glyphs == 0 || first_glyph > last_glyph) {
+        std::cerr << "The font only has " << face->num_glyphs << " glyphs" << std::endl;
+        FT_Done_Face(face);
+        FT_Done_FreeType(ft_lib);
+        return false;
+    }
+    unsigned int n_glyphs = last_glyph - first_glyph + 1;
+    unsigned int n_chunks = (n_glyphs + export_chunk_glyphs - 1) / export_chunk_glyphs;
+
+    // every worker has its own face, all opened before the threads start so none can fail halfway
+    unsigned int n_threads = std::max(options.n_threads, 1u);
+    std::vector<FT_Library> worker_libs(n_threads, nullptr);
+    std::vector<FT_Face> worker_faces(n_threads, nullptr);
+    auto close_workers = [&]() {
+        for (unsigned int t = 0; t < n_threads; t++) {
+            if (worker_faces[t]) FT_Done_Face(worker_faces[t]);
+            if (worker_libs[t]) FT_Done_FreeType(worker_libs[t]);
+        }
+    };
+    for (unsigned int t = 0; t < n_threads; t++) {
+        if (FT_Init_FreeType(&worker_libs[t]) ||
+            FT_New_Memory_Face(worker_libs[t], reinterpret_cast<const FT_Byte*>(font.data()), font.size(), face_index, &worker_faces[t])) {
+            std::cerr << "Failed to open the face to export" << std::endl;
+            close_workers();
+            FT_Done_Face(face);
+            FT_Done_FreeType(ft_lib);
+            return false;
+        }
+    }
+
+    FILE* f = std::fopen(options.output_path.c_str(), "wb");
+    if (!f) {
+        std::cerr << "Failed to create " << options.output_path << std::endl;
+        close_workers();
+        FT_Done_Face(face);
+        FT_Done_FreeType(ft_lib);
+        return false;
+    }
+
+    std::string header;
+    if (options.format == ExportFormat::Binary) {
+        ExportHeader binary_header;
+        std::memcpy(binary_header.magic, export_magic, sizeof(export_magic));
+        binary_header.version = export_version;
+        binary_header.flags = options.flattened ? export_flattened : 0;
+        binary_header.units_per_em = face->units_per_EM;
+        binary_header.ascender = face->ascender;
+        binary_header.descender = face->descender;
+        binary_header.first_glyph = first_glyph;
+        binary_header.n_glyphs = n_glyphs;
+        append_bytes(header, &binary_header, sizeof(binary_header));
+    } else {
+        unsigned int rows = (n_glyphs + svg_columns - 1) / svg_columns;
+        char text[160];
+        std::snprintf(text, sizeof(text), "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 %d %d\">\n",
+                      (int)(svg_columns * face->units_per_EM), (int)(rows * (face->ascender - face->descender)));
+        header = text;
+    }
+    FT_Done_Face(face);
+    FT_Done_FreeType(ft_lib);
+
+    bool ok = std::fwrite(header.data(), 1, header.size(), f) == header.size();
+    stats.bytes += header.size();
+
+    unsigned int max_ahead = export_chunks_ahead * n_threads;
+    std::mutex mutex;
+    std::condition_variable chunk_ready, chunk_written;
+    std::map<unsigned int, EncodedChunk> ready;
+    unsigned int next_chunk = 0, next_written = 0;
+    bool failed = false;
+
+    auto work = [&](FT_Face worker_face) {
+        GlyphPath path;
+        while (true) {
+            unsigned int chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                chunk_written.wait(lock, [&] { return failed || next_chunk >= n_chunks || next_chunk < next_written + max_ahead; });
+                if (failed || next_chunk >= n_chunks) break;
+                chunk = next_chunk++;
+            }
+
+            EncodedChunk encoded{std::string(), 0, 0};
+            unsigned int first = first_glyph + chunk * export_chunk_glyphs;
+            unsigned int last = std::min(first + export_chunk_glyphs - 1, last_glyph);
+            for (unsigned int glyph_index = first; glyph_index <= last; glyph_index++) {
+                GlyphStatus status = trace_glyph(worker_face, glyph_index, options, path);
+                if (options.format == ExportFormat::Binary) {
+                    append_binary(encoded.data, glyph_index, status, path);
+                } else if (status == GlyphStatus::Ok) {
+                    append_svg(encoded.data, worker_face, glyph_index, glyph_index - first_glyph, path);
+                }
+                encoded.n_glyphs++;
+                encoded.n_skipped += status != GlyphStatus::Ok;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.emplace(chunk, std::move(encoded));
+            chunk_ready.notify_all();
+        }
+
+        chunk_ready.notify_all();
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < n_threads; t++) {
+        threads.emplace_back(work, worker_faces[t]);
+    }
+
+    // chunks finish out of order, they are written in order
+    while (true) {
+        EncodedChunk encoded;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            chunk_ready.wait(lock, [&] { return failed || ready.count(next_written); });
+            if (failed && !ready.count(next_written)) {
+                chunk_written.notify_all();
+                break;
+            }
+            encoded = std::move(ready[next_written]);
+            ready.erase(next_written);
+        }
+
+        ok = ok && std::fwrite(encoded.data.data(), 1, encoded.data.size(), f) == encoded.data.size();
+        stats.bytes += encoded.data.size();
+        stats.n_glyphs += encoded.n_glyphs;
+        stats.n_skipped += encoded.n_skipped;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        next_written++;
+        if (!ok) failed = true;
+        chunk_written.notify_all();
+        if (next_written == n_chunks) break;
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    close_workers();
+
+    if (options.format == ExportFormat::Svg) {
+        const char footer[] = "</svg>\n";
+        ok = ok && std::fwrite(footer, 1, sizeof(footer) - 1, f) == sizeof(footer) - 1;
+        stats.bytes += sizeof(footer) - 1;
+    }
+    ok = std::fclose(f) == 0 && ok && !failed;
+    if (!ok) {
+        std::cerr << "Failed to write " << options.output_path << std::endl;
+        std::remove(options.output_path.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile;
+
+enum class ExportFormat {
+    Svg,     // one path per glyph, laid out in a grid
+    Binary,  // ExportHeader then one ExportGlyph record per glyph
+};
+
+struct ExportOptions {
+    std::string output_path;
+    ExportFormat format;
+    bool flattened;  // flattened contours instead of the curves of the outline
+    bool simplify;   // applies to flattened contours only
+    unsigned int first_glyph, last_glyph;  // inclusive glyph index range
+    unsigned int n_threads;
+};
+
+// Binary export, in the byte order of the machine that wrote it. Each
+// ExportGlyph is followed by its command bytes, padded to 4 bytes, then by
+// its points as pairs of floats in font units, y going up.
+static const uint32_t export_flattened = 1;
+
+struct ExportHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t units_per_em;
+    int32_t ascender, descender;
+    uint32_t first_glyph, n_glyphs;
+};
+
+struct ExportGlyph {
+    uint32_t glyph_index;
+    uint32_t status;  // GlyphStatus, glyphs that failed have no commands
+    float advance;
+    uint32_t n_commands, n_points;
+};
+
+// Commands take 1, 1, 2 and 3 points, every contour starting with a move and being closed
+enum ExportCommand : uint8_t {
+    MoveTo,
+    LineTo,
+    ConicTo,
+    CubicTo,
+};
+
+struct ExportStats {
+    size_t n_glyphs, n_skipped;
+    uint64_t bytes;
+};
+
+// Writes the outlines of the glyph range of a face into one file. Glyphs are
+// encoded in chunks by n_threads workers, each with its own FreeType face on
+// the mapping, and the chunks are written in order as soon as they are ready.
+// Workers do not run more than a few chunks ahead of the writer, so memory
+// does not grow with the number of glyphs.
+bool export_outlines(const MappedFile& font, unsigned int face_index, const ExportOptions& options, ExportStats& stats);
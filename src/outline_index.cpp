@@ -0,0 +1,159 @@
+#include "outline_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glm/geometric.hpp"
+#include "memory_usage.h"
+#include "outline.h"
+
+static const float items_per_cell = 2.f;
+static const int max_grid_size = 256;
+
+OutlineIndex::OutlineIndex(): origin(0, 0), cell_size(1), columns(0), rows(0), n_on_curve(0) {
+    memory_usage.addSource(this, MemoryCategory::Outlines, [this] { return cpuBytes(); });
+}
+
+OutlineIndex::~OutlineIndex() {
+    memory_usage.removeSource(this);
+}
+
+size_t OutlineIndex::cpuBytes() const {
+    size_t bytes = vector_bytes(points) + vector_bytes(segments);
+    for (const Grid* grid : {&point_grid, &segment_grid}) {
+        bytes += vector_bytes(grid->start) + vector_bytes(grid->items);
+    }
+    return bytes;
+}
+
+void OutlineIndex::build(const ControlPoints& control_points, const std::vector<std::vector<glm::vec2>>& contours) {
+    points = control_points.on_curve;
+    points.insert(points.end(), control_points.off_curve.begin(), control_points.off_curve.end());
+    n_on_curve = control_points.on_curve.size();
+
+    segments.clear();
+    for (const auto& contour : contours) {
+        for (size_t i = 1; i < contour.size(); i++) {
+            segments.push_back(contour[i-1]);
+            segments.push_back(contour[i]);
+        }
+    }
+
+    point_grid = Grid();
+    segment_grid = Grid();
+    columns = rows = 0;
+    if (points.empty() && segments.empty()) return;
+
+    glm::vec2 min = !points.empty() ? points[0] : segments[0];
+    glm::vec2 max = min;
+    for (glm::vec2 p : points) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    for (glm::vec2 p : segments) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    glm::vec2 extent = glm::max(max - min, glm::vec2(1e-6f, 1e-6f));
+    float n_cells = std::max(1.f, (float)(points.size() + segments.size() / 2) / items_per_cell);
+    cell_size = std::sqrt(extent.x * extent.y / n_cells);
+    cell_size = std::max({cell_size, extent.x / max_grid_size, extent.y / max_grid_size});
+    origin = min;
+    columns = std::max(1, (int)std::ceil(extent.x / cell_size));
+    rows = std::max(1, (int)std::ceil(extent.y / cell_size));
+
+    fill(point_grid, points, points);
+
+    std::vector<glm::vec2> segment_min, segment_max;
+    for (size_t i = 0; i < segments.size(); i += 2) {
+        segment_min.push_back(glm::min(segments[i], segments[i+1]));
+        segment_max.push_back(glm::max(segments[i], segments[i+1]));
+    }
+    fill(segment_grid, segment_min, segment_max);
+}
+
+void OutlineIndex::cellRange(glm::vec2 min, glm::vec2 max, int& x0, int& y0, int& x1, int& y1) const {
+    x0 = std::clamp((int)std::floor((min.x - origin.x) / cell_size), 0, columns - 1);
+    y0 = std::clamp((int)std::floor((min.y - origin.y) / cell_size), 0, rows - 1);
+    x1 = std::clamp((int)std::floor((max.x - origin.x) / cell_size), 0, columns - 1);
+    y1 = std::clamp((int)std::floor((max.y - origin.y) / cell_size), 0, rows - 1);
+}
+
+void OutlineIndex::fill(Grid& grid, const std::vector<glm::vec2>& item_min, const std::vector<glm::vec2>& item_max) const {
+    // count the items of each cell, then place them with the prefix sums as cursors
+    grid.start.assign(columns * rows + 1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < item_min.size(); i++) {
+            int x0, y0, x1, y1;
+            cellRange(item_min[i], item_max[i], x0, y0, x1, y1);
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    if (pass == 0) {
+                        grid.start[y*columns + x + 1]++;
+                    } else {
+                        grid.items[grid.start[y*columns + x]++] = (unsigned int)i;
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (size_t c = 1; c < grid.start.size(); c++) {
+                grid.start[c] += grid.start[c-1];
+            }
+            grid.items.resize(grid.start.back());
+        } else {
+            // the cursors ended on the start of the next cell
+            std::rotate(grid.start.rbegin(), grid.start.rbegin() + 1, grid.start.rend());
+            grid.start[0] = 0;
+        }
+    }
+}
+
+OutlinePick OutlineIndex::pick(glm::vec2 p, float max_distance) const {
+    OutlinePick result;
+    result.distance = max_distance;
+    if (columns == 0) return result;
+
+    glm::vec2 radius(max_distance, max_distance);
+    int x0, y0, x1, y1;
+    cellRange(p - radius, p + radius, x0, y0, x1, y1);
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            int cell = y*columns + x;
+            for (unsigned int i = point_grid.start[cell]; i < point_grid.start[cell+1]; i++) {
+                unsigned int item = point_grid.items[i];
+                float distance = glm::length(points[item] - p);
+                if (distance <= result.distance) {
+                    bool on_curve = item < n_on_curve;
+                    result.kind = on_curve ? OutlinePick::OnCurve : OutlinePick::OffCurve;
+                    result.index = on_curve ? item : item - n_on_curve;
+                    result.a = result.b = points[item];
+                    result.distance = distance;
+                }
+            }
+        }
+    }
+    if (result.kind != OutlinePick::None) return result;
+
+    // segments spanning several cells are seen more than once, which is harmless
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            int cell = y*columns + x;
+            for (unsigned int i = segment_grid.start[cell]; i < segment_grid.start[cell+1]; i++) {
+                unsigned int item = segment_grid.items[i];
+                float distance = segment_distance(p, segments[2*item], segments[2*item + 1]);
+                if (distance <= result.distance) {
+                    result.kind = OutlinePick::Segment;
+                    result.index = item;
+                    result.a = segments[2*item];
+                    result.b = segments[2*item + 1];
+                    result.distance = distance;
+                }
+            }
+        }
+    }
+    return result;
+}
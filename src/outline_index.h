@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "glm/vec2.hpp"
+
+struct ControlPoints;
+
+struct OutlinePick {
+    enum Kind {
+        None,
+        OnCurve,
+        OffCurve,
+        Segment,
+    };
+
+    Kind kind = None;
+    size_t index = 0;  // into the points of its kind, or the segments of the flattened contours
+    glm::vec2 a, b;    // the point, or the ends of the segment
+    float distance = 0;
+};
+
+// Uniform grid over the control points and the flattened segments of one
+// glyph, so that picking only looks at the cells around the cursor. The cell
+// size is chosen from the number of items so that cells hold a couple of
+// items each on average.
+class OutlineIndex {
+public:
+    OutlineIndex();
+    ~OutlineIndex();
+
+    OutlineIndex(const OutlineIndex&) = delete;
+    OutlineIndex& operator=(const OutlineIndex&) = delete;
+
+    void build(const ControlPoints& points, const std::vector<std::vector<glm::vec2>>& contours);
+
+    // Nearest control point within max_distance, falling back to the nearest segment
+    OutlinePick pick(glm::vec2 p, float max_distance) const;
+
+    size_t segmentCount() const { return segments.size() / 2; }
+    size_t cpuBytes() const;
+
+private:
+    // Items of each cell stored contiguously, cell c holding items[start[c]] to items[start[c+1]]
+    struct Grid {
+        std::vector<unsigned int> start;
+        std::vector<unsigned int> items;
+    };
+
+    void fill(Grid& grid, const std::vector<glm::vec2>& item_min, const std::vector<glm::vec2>& item_max) const;
+    // Range of cells overlapping [min, max], clamped to the grid
+    void cellRange(glm::vec2 min, glm::vec2 max, int& x0, int& y0, int& x1, int& y1) const;
+
+    glm::vec2 origin;
+    float cell_size;
+    int columns, rows;
+
+    std::vector<glm::vec2> points;  // on-curve points, then off-curve ones
+    size_t n_on_curve;
+    std::vector<glm::vec2> segments;  // pairs of ends
+    Grid point_grid, segment_grid;
+};
@@ -0,0 +1,153 @@
+#include "program_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "cache_dir.h"
+#include "gl_extensions.h"
+
+static const char binary_magic[4] = {'F', 'V', 'P', 'B'};
+static const uint32_t binary_version = 1;
+
+struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t driver_hash;
+    uint32_t format;
+    uint32_t length;
+};
+
+unsigned int compile_program(const char* vertex_src, const char* fragment_src) {
+    unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex_shader, 1, &vertex_src, nullptr);
+    glCompileShader(vertex_shader);
+
+    unsigned int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 1, &fragment_src, nullptr);
+    glCompileShader(fragment_shader);
+
+    int ret;
+    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &ret);
+    if (!ret) {
+        std::cerr << "vertex shader compilation failed" << std::endl;
+        std::exit(1);
+    }
+    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &ret);
+    if (!ret) {
+        std::cerr << "fragment shader compilation failed" << std::endl;
+        std::exit(1);
+    }
+
+    unsigned int program = glCreateProgram();
+    if (gl_ext.program_binary) {
+        gl_ext.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    return program;
+}
+
+ProgramCache::ProgramCache(bool enabled): enabled(enabled && gl_ext.program_binary), driver_hash(0), n_hits(0), n_misses(0) {
+    if (!this->enabled) return;
+
+    directory = cache_directory();
+    if (directory.empty()) {
+        this->enabled = false;
+        return;
+    }
+
+    std::string driver;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        driver += value ? value : "";
+        driver += '\n';
+    }
+    driver_hash = hash_bytes(driver.data(), driver.size());
+}
+
+unsigned int ProgramCache::program(const char* vertex_src, const char* fragment_src) {
+    if (!enabled) {
+        n_misses++;
+        return compile_program(vertex_src, fragment_src);
+    }
+
+    std::string sources = std::string(vertex_src) + '\0' + fragment_src;
+    char name[64];
+    std::snprintf(name, sizeof(name), "/program-%016llx.bin", (unsigned long long)hash_bytes(sources.data(), sources.size()));
+    std::string path = directory + name;
+
+    unsigned int program = loadBinary(path);
+    if (program) {
+        n_hits++;
+        return program;
+    }
+
+    n_misses++;
+    program = compile_program(vertex_src, fragment_src);
+    storeBinary(path, program);
+    return program;
+}
+
+unsigned int ProgramCache::loadBinary(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return 0;
+
+    BinaryHeader header;
+    std::vector<char> binary;
+    bool valid = std::fread(&header, sizeof(header), 1, f) == 1
+        && !std::memcmp(header.magic, binary_magic, sizeof(binary_magic))
+        && header.version == binary_version
+        && header.driver_hash == driver_hash;
+    if (valid) {
+        binary.resize(header.length);
+        valid = std::fread(binary.data(), 1, binary.size(), f) == binary.size();
+    }
+    std::fclose(f);
+    if (!valid) return 0;
+
+    unsigned int program = glCreateProgram();
+    gl_ext.ProgramBinary(program, header.format, binary.data(), (int)binary.size());
+
+    // the driver may reject binaries even with a matching version string
+    int status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCache::storeBinary(const std::string& path, unsigned int program) {
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    BinaryHeader header;
+    std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+    header.version = binary_version;
+    header.driver_hash = driver_hash;
+
+    std::vector<char> binary(length);
+    GLenum format;
+    gl_ext.GetProgramBinary(program, length, &length, &format, binary.data());
+    header.format = format;
+    header.length = length;
+
+    // written next to the final path and renamed so that readers never see a partial file
+    std::string tmp_path = path + ".tmp";
+    FILE* f = std::fopen(tmp_path.c_str(), "wb");
+    if (!f) return;
+    bool written = std::fwrite(&header, sizeof(header), 1, f) == 1 && std::fwrite(binary.data(), 1, length, f) == (size_t)length;
+    written = std::fclose(f) == 0 && written;
+    if (!written || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Compiles shader programs, keeping their binaries on disk when the driver
+// supports glGetProgramBinary. Binaries are keyed by the shader sources and
+// invalidated when the GL vendor, renderer or version string changes; any
+// failure falls back to compiling from source.
+class ProgramCache {
+public:
+    explicit ProgramCache(bool enabled = true);
+
+    unsigned int program(const char* vertex_src, const char* fragment_src);
+
+    unsigned int hits() const { return n_hits; }
+    unsigned int misses() const { return n_misses; }
+
+private:
+    unsigned int loadBinary(const std::string& path);
+    void storeBinary(const std::string& path, unsigned int program);
+
+    bool enabled;
+    std::string directory;
+    uint64_t driver_hash;
+    unsigned int n_hits, n_misses;
+};
+
+// Compiles and links from source, exits on failure
+unsigned int compile_program(const char* vertex_src, const char* fragment_src);
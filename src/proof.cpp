@@ -0,0 +1,268 @@
+#include "proof.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#include "glad.h"
+#include "glyph_cache.h"
+#include "line_renderer.h"
+#include "png.h"
+
+static const int proof_columns = 8;
+static const int proof_pbo_count = 3;
+static const size_t max_pending_images = 4 * proof_columns * proof_columns;
+
+static bool write_png(const std::string& path, int size, const unsigned char* pixels) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!info || setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        std::fclose(f);
+        return false;
+    }
+
+    png_init_io(png, f);
+    png_set_IHDR(png, info, size, size, 8, PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    for (int y = 0; y < size; y++) {
+        png_write_row(png, pixels + y*size);
+    }
+    png_write_end(png, nullptr);
+    png_destroy_write_struct(&png, &info);
+
+    return std::fclose(f) == 0;
+}
+
+// Encodes images on a background thread, blocking producers when too many are pending
+class PngWriter {
+public:
+    struct Image {
+        std::string path;
+        int size;
+        std::vector<unsigned char> pixels;
+    };
+
+    PngWriter(): done(false), n_written(0), n_failed(0), thread(&PngWriter::run, this) {}
+
+    ~PngWriter() {
+        finish();
+    }
+
+    // Waits for every pending image to be written
+    void finish() {
+        if (!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        ready.notify_all();
+        thread.join();
+    }
+
+    void push(Image&& image) {
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [this] { return queue.size() < max_pending_images; });
+        queue.push_back(std::move(image));
+        ready.notify_one();
+    }
+
+    unsigned int written() const { return n_written; }
+    unsigned int failed() const { return n_failed; }
+
+private:
+    void run() {
+        while (true) {
+            Image image;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return done || !queue.empty(); });
+                if (queue.empty()) return;
+                image = std::move(queue.front());
+                queue.pop_front();
+            }
+            space.notify_one();
+
+            if (write_png(image.path, image.size, image.pixels.data())) {
+                n_written++;
+            } else {
+                std::cerr << "Failed to write " << image.path << std::endl;
+                n_failed++;
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable ready, space;
+    std::deque<Image> queue;
+    bool done;
+    unsigned int n_written, n_failed;
+    std::thread thread;
+};
+
+struct ProofBatch {
+    unsigned int first_glyph, n_glyphs;
+    uint64_t skipped;  // tiles of the glyphs that failed to load, no image is written for them
+    GLsync fence;
+};
+static_assert(proof_columns * proof_columns <= 64, "a batch does not fit in the skipped mask");
+
+static void read_batch(ProofBatch& batch, unsigned int pbo, const ProofOptions& options, PngWriter& writer) {
+    int tile = options.tile_size;
+    int width = tile * proof_columns;
+
+    while (glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(batch.fence);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    const unsigned char* pixels = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, width*width, GL_MAP_READ_BIT));
+
+    for (unsigned int i = 0; i < batch.n_glyphs; i++) {
+        if ((batch.skipped >> i) & 1) continue;
+        int column = i % proof_columns;
+        int row = i / proof_columns;
+
+        PngWriter::Image image;
+        char name[32];
+        std::snprintf(name, sizeof(name), "/glyph-%05u.png", batch.first_glyph + i);
+        image.path = options.output_dir + name;
+        image.size = tile;
+        image.pixels.resize(tile*tile);
+
+        // GL rows go bottom to top
+        for (int y = 0; y < tile; y++) {
+            const unsigned char* src = pixels + (row*tile + tile - 1 - y)*width + column*tile;
+            std::copy(src, src + tile, image.pixels.begin() + y*tile);
+        }
+        writer.push(std::move(image));
+    }
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void render_proofs(LineRenderer& renderer, GlyphCache& cache, const ProofOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+
+    if (mkdir(options.output_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Failed to create " << options.output_dir << std::endl;
+        std::exit(1);
+    }
+
+    int tile = options.tile_size;
+    int width = tile * proof_columns;
+    unsigned int batch_size = proof_columns * proof_columns;
+
+    unsigned int fbo, color;
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, width);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Proof framebuffer is incomplete" << std::endl;
+        std::exit(1);
+    }
+
+    unsigned int pbos[proof_pbo_count];
+    glGenBuffers(proof_pbo_count, pbos);
+    for (unsigned int pbo : pbos) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, width*width, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    renderer.setView(glm::vec2(1, 1), glm::vec2(0, 0));
+    float descender = (float)cache.face()->descender / cache.height();
+
+    PngWriter writer;
+    std::vector<ProofBatch> batches;
+    std::vector<GlyphInstance> instance(1);
+
+    unsigned int n_glyphs = options.last_glyph - options.first_glyph + 1;
+    unsigned int n_batches = (n_glyphs + batch_size - 1) / batch_size;
+    for (unsigned int b = 0; b < n_batches; b++) {
+        unsigned int first = options.first_glyph + b * batch_size;
+        ProofBatch batch;
+        batch.first_glyph = first;
+        batch.n_glyphs = std::min(batch_size, options.last_glyph - first + 1);
+        batch.skipped = 0;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glDisable(GL_SCISSOR_TEST);
+        glViewport(0, 0, width, width);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // wide glyphs overflow the unit square, so each tile is scissored to keep them out of their neighbours
+        glEnable(GL_SCISSOR_TEST);
+        for (unsigned int i = 0; i < batch.n_glyphs; i++) {
+            const GlyphGeometry* geometry;
+            if (cache.load(first + i, geometry) != GlyphStatus::Ok) {
+                batch.skipped |= uint64_t(1) << i;
+                continue;
+            }
+            int x = (i % proof_columns) * tile;
+            int y = (i / proof_columns) * tile;
+            glViewport(x, y, tile, tile);
+            glScissor(x, y, tile, tile);
+
+            instance[0] = GlyphInstance{first + i, glm::vec2(-geometry->bearing_x, -descender)};
+            renderer.drawGlyphInstances(cache, instance);
+            // the viewport and scissor of the tile only apply to the draws submitted before they change
+            renderer.submit();
+        }
+        glDisable(GL_SCISSOR_TEST);
+
+        // the copy into the PBO completes asynchronously, it is only mapped a few passes later
+        unsigned int pbo = pbos[batches.size() % proof_pbo_count];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glReadPixels(0, 0, width, width, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        batches.push_back(batch);
+
+        if (batches.size() >= proof_pbo_count) {
+            size_t oldest = batches.size() - proof_pbo_count;
+            read_batch(batches[oldest], pbos[oldest % proof_pbo_count], options, writer);
+        }
+    }
+
+    size_t first_unread = batches.size() >= proof_pbo_count ? batches.size() - proof_pbo_count + 1 : 0;
+    for (size_t i = first_unread; i < batches.size(); i++) {
+        read_batch(batches[i], pbos[i % proof_pbo_count], options, writer);
+    }
+
+    glDeleteBuffers(proof_pbo_count, pbos);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &color);
+
+    writer.finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote " << writer.written() << " proofs in " << seconds << " s";
+    if (writer.failed()) {
+        std::cout << ", " << writer.failed() << " failed";
+    }
+    std::cout << std::endl;
+
+    for (GlyphStatus status : {GlyphStatus::InvalidIndex, GlyphStatus::LoadFailed, GlyphStatus::NotOutline}) {
+        if (size_t n = cache.failures(status)) {
+            std::cout << "Skipped " << n << " glyphs: " << glyph_status_name(status) << std::endl;
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+class GlyphCache;
+class LineRenderer;
+
+struct ProofOptions {
+    std::string output_dir;
+    unsigned int first_glyph, last_glyph;  // inclusive glyph index range
+    int tile_size;                         // size in pixels of each PNG
+};
+
+// Renders each glyph of the range into its own PNG. Glyphs are drawn in
+// scissored tiles of a shared framebuffer, read back through a ring of pixel
+// buffer objects so the next pass renders while the previous one transfers,
+// and encoded on a writer thread.
+void render_proofs(LineRenderer& renderer, GlyphCache& cache, const ProofOptions& options);
@@ -0,0 +1,121 @@
+#include "stream_buffer.h"
+
+#include <cstring>
+
+#include "gl_extensions.h"
+#include "memory_usage.h"
+
+// vertex attributes read from the ring start on this boundary
+static const size_t stream_alignment = 16;
+
+StreamBuffer::StreamBuffer(size_t section_size): buf(0), section_size(0), mapped(nullptr), section(0), frame_base(0), used(0), frame_started(false) {
+    for (GLsync& fence : fences) {
+        fence = nullptr;
+    }
+    allocate(section_size);
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync fence : fences) {
+        if (fence) glDeleteSync(fence);
+    }
+    // deleting the buffer also unmaps it
+    memory_usage.releaseBuffer(buf);
+    glDeleteBuffers(1, &buf);
+}
+
+void StreamBuffer::allocate(size_t new_section_size) {
+    section_size = new_section_size;
+    size_t size = section_size * stream_sections;
+
+    glGenBuffers(1, &buf);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buf);
+    if (gl_ext.buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl_ext.BufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        mapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    memory_usage.setBuffer(buf, "stream ring", size);
+}
+
+void StreamBuffer::grow(size_t needed) {
+    size_t new_section_size = section_size;
+    while (new_section_size < needed) {
+        new_section_size *= 2;
+    }
+
+    // the old buffer lives on until the frames reading it are done, so there is nothing to wait for
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    unsigned int old_buf = buf;
+    if (mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, old_buf);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        mapped = nullptr;
+    }
+
+    // the data of the frame is copied to the same offset, where the offsets returned so far
+    // still find it, and the frame goes on from there with the room of a new section
+    allocate(new_section_size);
+    if (used > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, old_buf);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buf);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, frame_base, frame_base, used);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    memory_usage.releaseBuffer(old_buf);
+    glDeleteBuffers(1, &old_buf);
+}
+
+size_t StreamBuffer::write(const void* data, size_t size) {
+    if (!frame_started) {
+        section = (section + 1) % stream_sections;
+        frame_base = section * section_size;
+        used = 0;
+        frame_started = true;
+        // the section was last read by the frame stream_sections ago, which is usually done by now
+        if (fences[section]) {
+            while (glClientWaitSync(fences[section], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(fences[section]);
+            fences[section] = nullptr;
+        }
+    }
+
+    size_t start = (used + stream_alignment - 1) / stream_alignment * stream_alignment;
+    if (start + size > section_size) {
+        grow(start + size);
+    }
+    size_t offset = frame_base + start;
+    used = start + size;
+    if (size == 0) return offset;
+
+    if (mapped) {
+        std::memcpy(mapped + offset, data, size);
+    } else {
+        // the fences already keep the GPU out of this range
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buf);
+        void* target = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        std::memcpy(target, data, size);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    return offset;
+}
+
+void StreamBuffer::finishFrame() {
+    if (!frame_started) return;
+    // a frame that grew the buffer may straddle two of its sections, both wait for it
+    for (int k = 0; k < stream_sections; k++) {
+        size_t begin = k * section_size, end = begin + section_size;
+        if (k != section && (frame_base + used <= begin || frame_base >= end)) continue;
+        if (fences[k]) glDeleteSync(fences[k]);
+        fences[k] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    frame_started = false;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+
+#include "glad.h"
+
+// Sections of the ring, one being written while the GPU may still read the others
+static const int stream_sections = 3;
+
+// Vertex data rewritten every frame, such as instance offsets and overlays.
+// The buffer is a ring of sections, each frame appending to the next section
+// after waiting on the fence of the frame that last used it, so writes never
+// make the driver synchronize or reallocate. With ARB_buffer_storage the
+// buffer stays persistently mapped and a write is a memcpy, otherwise each
+// write maps its range unsynchronized.
+class StreamBuffer {
+public:
+    explicit StreamBuffer(size_t section_size);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Appends the data to the section of the current frame and returns its
+    // offset in buffer(). The buffer is replaced by a larger one, keeping
+    // the data of the frame at the offsets already returned, when a frame
+    // does not fit in a section.
+    size_t write(const void* data, size_t size);
+    // Fences the section once the draws reading it are issued, the next write starts the next section
+    void finishFrame();
+
+    unsigned int buffer() const { return buf; }
+    bool persistent() const { return mapped != nullptr; }
+
+private:
+    void allocate(size_t new_section_size);
+    void grow(size_t needed);
+
+    unsigned int buf;
+    size_t section_size;
+    char* mapped;  // whole buffer when persistently mapped
+    int section;        // of the current frame
+    size_t frame_base;  // start of the data of the current frame, the start of its section unless it grew the buffer
+    size_t used;        // bytes written in it
+    bool frame_started;
+    GLsync fences[stream_sections];
+};
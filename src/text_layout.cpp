@@ -0,0 +1,105 @@
+#include "text_layout.h"
+
+#include <algorithm>
+#include <cstring>
+
+unsigned int decode_utf8(const char*& it, const char* end) {
+    unsigned char c = (unsigned char)*it++;
+    if (c < 0x80) return c;
+
+    int length;
+    unsigned int codepoint;
+    if ((c & 0xE0) == 0xC0) {
+        length = 1;
+        codepoint = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        length = 2;
+        codepoint = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        length = 3;
+        codepoint = c & 0x07;
+    } else {
+        return 0xFFFD;
+    }
+
+    for (int i = 0; i < length; i++) {
+        if (it == end || ((unsigned char)*it & 0xC0) != 0x80) return 0xFFFD;
+        codepoint = (codepoint << 6) | ((unsigned char)*it++ & 0x3F);
+    }
+    return codepoint;
+}
+
+void encode_utf8(unsigned int codepoint, std::string& out) {
+    if (codepoint < 0x80) {
+        out += (char)codepoint;
+    } else if (codepoint < 0x800) {
+        out += (char)(0xC0 | (codepoint >> 6));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        out += (char)(0xE0 | (codepoint >> 12));
+        out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    } else {
+        out += (char)(0xF0 | (codepoint >> 18));
+        out += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+        out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    }
+}
+
+void pop_utf8(std::string& text) {
+    while (!text.empty()) {
+        unsigned char c = (unsigned char)text.back();
+        text.pop_back();
+        if ((c & 0xC0) != 0x80) break;
+    }
+}
+
+void layout_text(GlyphCache& cache, const char* begin, const char* end, TextLayout& layout, float max_width) {
+    FT_Face face = cache.face();
+    float line_height = (float)face->height / cache.height();
+    bool kerning = FT_HAS_KERNING(face);
+
+    layout.instances.clear();
+    layout.width = 0;
+
+    glm::vec2 pen(0, -(float)face->ascender / cache.height());
+    unsigned int previous = 0;
+    unsigned int n_lines = 1;
+
+    for (const char* it = begin; it != end;) {
+        unsigned int codepoint = decode_utf8(it, end);
+        if (codepoint == '\n') {
+            pen.x = 0;
+            pen.y -= line_height;
+            previous = 0;
+            n_lines++;
+            continue;
+        }
+        if (codepoint == '\r') {
+            continue;
+        }
+        if (pen.x > max_width) {
+            const char* newline = static_cast<const char*>(std::memchr(it, '\n', end - it));
+            it = newline ? newline : end;
+            continue;
+        }
+
+        unsigned int glyph_index = FT_Get_Char_Index(face, codepoint);
+        if (kerning && previous && glyph_index) {
+            FT_Vector delta;
+            FT_Get_Kerning(face, previous, glyph_index, FT_KERNING_UNSCALED, &delta);
+            pen.x += (float)delta.x / cache.height();
+        }
+
+        const GlyphGeometry& geometry = cache.get(glyph_index);
+        if (geometry.index_count > 0) {
+            layout.instances.push_back(GlyphInstance{glyph_index, pen});
+        }
+        pen.x += geometry.advance;
+        layout.width = std::max(layout.width, pen.x);
+        previous = glyph_index;
+    }
+
+    layout.height = 1.f + (float)(n_lines - 1) * line_height;
+}
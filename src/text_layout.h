@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "glyph_cache.h"
+
+struct TextLayout {
+    std::vector<GlyphInstance> instances;
+    // bounding box of the laid out lines, the first line's top is at y = 0
+    float width, height;
+};
+
+// Decodes one UTF-8 sequence starting at it, invalid bytes decode to U+FFFD
+unsigned int decode_utf8(const char*& it, const char* end);
+void encode_utf8(unsigned int codepoint, std::string& out);
+// Removes the last UTF-8 sequence of the string
+void pop_utf8(std::string& text);
+
+// Lays out the text with the glyph advances and kerning of the face,
+// loading the geometry of every glyph into the cache. Glyphs starting past
+// max_width are skipped so that very long lines cost no more than visible ones.
+void layout_text(GlyphCache& cache, const char* begin, const char* end, TextLayout& layout, float max_width = INFINITY);
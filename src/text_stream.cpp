@@ -0,0 +1,168 @@
+#include "text_stream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "memory_usage.h"
+#include "text_layout.h"
+
+TextStream::TextStream(const char* data, size_t size): text(data), text_size(size), checkpoints_complete(false), last_line(0), last_offset(0) {
+    checkpoints.push_back(0);
+    memory_usage.addSource(this, MemoryCategory::TextLayout, [this] { return vector_bytes(checkpoints); });
+}
+
+TextStream::~TextStream() {
+    memory_usage.removeSource(this);
+}
+
+size_t TextStream::skipLines(size_t offset, size_t count, size_t& skipped) const {
+    skipped = 0;
+    while (skipped < count && offset < text_size) {
+        const char* newline = static_cast<const char*>(std::memchr(text + offset, '\n', text_size - offset));
+        if (!newline) {
+            offset = text_size;
+            break;
+        }
+        offset = newline - text + 1;
+        skipped++;
+    }
+    return offset;
+}
+
+bool TextStream::lineStart(size_t n, size_t& offset) {
+    size_t k = n / checkpoint_interval;
+    while (checkpoints.size() <= k) {
+        if (checkpoints_complete) return false;
+
+        size_t skipped;
+        size_t next = skipLines(checkpoints.back(), checkpoint_interval, skipped);
+        if (skipped < checkpoint_interval || next >= text_size) {
+            checkpoints_complete = true;
+            if (skipped < checkpoint_interval) return false;
+        }
+        checkpoints.push_back(next);
+    }
+
+    size_t start = checkpoints[k];
+    size_t first = k * checkpoint_interval;
+    if (last_line >= first && last_line <= n) {
+        start = last_offset;
+        first = last_line;
+    }
+
+    size_t skipped;
+    offset = skipLines(start, n - first, skipped);
+    if (skipped < n - first) return false;
+    // a trailing newline does not start another line
+    if (offset >= text_size && n > 0) return false;
+
+    last_line = n;
+    last_offset = offset;
+    return true;
+}
+
+bool TextStream::line(size_t n, const char*& begin, const char*& end) {
+    size_t offset;
+    if (!lineStart(n, offset)) return false;
+
+    begin = end = text + offset;
+    // the only line of an empty text is empty, and its mapping may be null
+    if (offset == text_size) return true;
+
+    const char* newline = static_cast<const char*>(std::memchr(begin, '\n', text_size - offset));
+    end = newline ? newline : text + text_size;
+    return true;
+}
+
+size_t TextStream::lineCount() {
+    size_t offset;
+    while (!checkpoints_complete) {
+        lineStart(checkpoints.size() * checkpoint_interval, offset);
+    }
+
+    size_t newlines;
+    skipLines(checkpoints.back(), checkpoint_interval, newlines);
+    newlines += (checkpoints.size() - 1) * checkpoint_interval;
+
+    bool unterminated = text_size > 0 && text[text_size - 1] != '\n';
+    return std::max<size_t>(newlines + (unterminated ? 1 : 0), 1);
+}
+
+TextStreamView::TextStreamView(TextStream& stream, GlyphCache& cache, unsigned int visible_lines, unsigned int prefetch_lines):
+    stream(stream), cache(cache), n_visible(visible_lines), n_prefetch(prefetch_lines), top_line(0), dirty(true) {
+    FT_Face face = cache.face();
+    line_height = (float)face->height / cache.height();
+    memory_usage.addSource(this, MemoryCategory::TextLayout, [this] { return cpuBytes(); });
+}
+
+TextStreamView::~TextStreamView() {
+    memory_usage.removeSource(this);
+}
+
+size_t TextStreamView::cpuBytes() const {
+    size_t bytes = map_bytes(lines) + vector_bytes(visible_instances);
+    for (const auto& line : lines) {
+        bytes += vector_bytes(line.second);
+    }
+    return bytes;
+}
+
+void TextStreamView::scroll(float delta) {
+    scrollTo(top_line + delta);
+}
+
+void TextStreamView::scrollTo(float line) {
+    top_line = std::max(line, 0.f);
+    dirty = true;
+}
+
+void TextStreamView::scrollToEnd() {
+    size_t n_lines = stream.lineCount();
+    scrollTo((float)n_lines - (float)n_visible);
+}
+
+void TextStreamView::invalidate() {
+    lines.clear();
+    dirty = true;
+}
+
+void TextStreamView::update() {
+    if (!dirty) return;
+    dirty = false;
+
+    size_t first_visible = (size_t)std::floor(top_line);
+    size_t first = first_visible > n_prefetch ? first_visible - n_prefetch : 0;
+    size_t last = first_visible + n_visible + n_prefetch;
+
+    for (auto it = lines.begin(); it != lines.end();) {
+        if (it->first < first || it->first > last) {
+            it = lines.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    TextLayout layout;
+    for (size_t n = first; n <= last; n++) {
+        if (lines.count(n)) continue;
+
+        const char* begin;
+        const char* end;
+        if (!stream.line(n, begin, end)) break;
+
+        layout_text(cache, begin, end, layout, viewWidth());
+        lines[n] = layout.instances;
+    }
+
+    visible_instances.clear();
+    for (size_t n = first_visible; n <= first_visible + n_visible; n++) {
+        auto it = lines.find(n);
+        if (it == lines.end()) break;
+
+        for (GlyphInstance instance : it->second) {
+            instance.offset.y -= (float)n * line_height;
+            visible_instances.push_back(instance);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "glyph_cache.h"
+
+// Line access into a large text buffer (typically a MappedFile) without
+// indexing every line: only the offset of every checkpoint_interval-th
+// line is remembered, and it is built lazily as lines are requested.
+class TextStream {
+public:
+    TextStream(const char* data, size_t size);
+    ~TextStream();
+
+    TextStream(const TextStream&) = delete;
+    TextStream& operator=(const TextStream&) = delete;
+
+    // Returns false if the line is past the end of the text
+    bool line(size_t n, const char*& begin, const char*& end);
+    // Scans the rest of the text on first call
+    size_t lineCount();
+
+private:
+    bool lineStart(size_t n, size_t& offset);
+    size_t skipLines(size_t offset, size_t count, size_t& skipped) const;
+
+    static const size_t checkpoint_interval = 256;
+
+    const char* text;
+    size_t text_size;
+    std::vector<size_t> checkpoints;
+    bool checkpoints_complete;
+    // last lookup, visible lines are requested in order
+    size_t last_line, last_offset;
+};
+
+// Lays out the lines of a TextStream around the visible viewport. Lines
+// outside of the viewport plus a prefetch window on each side are dropped,
+// so memory stays bounded by the viewport size rather than the file size.
+class TextStreamView {
+public:
+    TextStreamView(TextStream& stream, GlyphCache& cache, unsigned int visible_lines, unsigned int prefetch_lines);
+    ~TextStreamView();
+
+    TextStreamView(const TextStreamView&) = delete;
+    TextStreamView& operator=(const TextStreamView&) = delete;
+
+    void scroll(float lines);
+    void scrollTo(float line);
+    void scrollToEnd();
+
+    // Lays out the missing lines and rebuilds the instance list
+    void update();
+    // Drops the laid out lines, for when glyph advances change
+    void invalidate();
+
+    const std::vector<GlyphInstance>& instances() const { return visible_instances; }
+    float top() const { return top_line; }
+    float lineHeight() const { return line_height; }
+    unsigned int visibleLines() const { return n_visible; }
+    // width in layout units that fits in the viewport
+    float viewWidth() const { return (float)n_visible * line_height; }
+    // Heap bytes of the laid out lines
+    size_t cpuBytes() const;
+
+private:
+    TextStream& stream;
+    GlyphCache& cache;
+    unsigned int n_visible, n_prefetch;
+    float top_line;
+    float line_height;
+    bool dirty;
+
+    std::unordered_map<size_t, std::vector<GlyphInstance>> lines;
+    std::vector<GlyphInstance> visible_instances;
+};
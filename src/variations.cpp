@@ -0,0 +1,128 @@
+#include "variations.h"
+
+#include FT_MULTIPLE_MASTERS_H
+#include "glyph_lod.h"
+#include "mapped_file.h"
+
+std::vector<VariationAxis> variation_axes(FT_Face face) {
+    std::vector<VariationAxis> axes;
+    if (!FT_HAS_MULTIPLE_MASTERS(face)) return axes;
+
+    FT_MM_Var* mm;
+    if (FT_Get_MM_Var(face, &mm)) return axes;
+
+    for (FT_UInt i = 0; i < mm->num_axis; i++) {
+        const FT_Var_Axis& axis = mm->axis[i];
+        axes.push_back(VariationAxis{axis.name ? axis.name : "", axis.tag,
+                                     (float)axis.minimum / 65536.f, (float)axis.def / 65536.f, (float)axis.maximum / 65536.f});
+    }
+
+    FT_Done_MM_Var(face->glyph->library, mm);
+    return axes;
+}
+
+std::vector<float> normalized_coords(FT_Face face, const std::vector<FT_Fixed>& design) {
+    std::vector<float> normalized;
+    FT_MM_Var* mm;
+    if (!FT_HAS_MULTIPLE_MASTERS(face) || FT_Get_MM_Var(face, &mm)) return normalized;
+    FT_UInt n_axes = mm->num_axis;
+    FT_Done_MM_Var(face->glyph->library, mm);
+
+    normalized.assign(n_axes, 0.f);
+    if (design.empty()) return normalized;
+
+    std::vector<FT_Fixed> previous(n_axes), blend(n_axes);
+    FT_Get_Var_Design_Coordinates(face, n_axes, previous.data());
+    FT_Set_Var_Design_Coordinates(face, design.size(), const_cast<FT_Fixed*>(design.data()));
+    FT_Get_Var_Blend_Coordinates(face, n_axes, blend.data());
+    FT_Set_Var_Design_Coordinates(face, n_axes, previous.data());
+
+    for (FT_UInt i = 0; i < n_axes; i++) {
+        normalized[i] = (float)blend[i] / 65536.f;
+    }
+    return normalized;
+}
+
+InstanceWorker::InstanceWorker(): ft_lib(nullptr), face(nullptr), simplify(false), pending(false), has_result(false), done(false), generation(0) {}
+
+InstanceWorker::~InstanceWorker() {
+    if (thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+    if (face) FT_Done_Face(face);
+    if (ft_lib) FT_Done_FreeType(ft_lib);
+}
+
+bool InstanceWorker::open(const MappedFile& font, unsigned int face_index, bool simplify) {
+    if (FT_Init_FreeType(&ft_lib)) return false;
+    if (FT_New_Memory_Face(ft_lib, reinterpret_cast<const FT_Byte*>(font.data()), font.size(), face_index, &face)) return false;
+
+    this->simplify = simplify;
+    thread = std::thread(&InstanceWorker::run, this);
+    return true;
+}
+
+void InstanceWorker::request(const std::vector<FT_Fixed>& coords, const std::vector<unsigned int>& glyph_indices) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_coords = coords;
+        pending_glyphs = glyph_indices;
+        pending = true;
+        generation++;
+    }
+    wake.notify_one();
+}
+
+bool InstanceWorker::poll(InstanceResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!has_result) return false;
+
+    result = std::move(finished);
+    has_result = false;
+    return true;
+}
+
+void InstanceWorker::run() {
+    while (true) {
+        InstanceResult result;
+        unsigned int started;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return done || pending; });
+            if (done) return;
+            result.coords = std::move(pending_coords);
+            result.glyph_indices = std::move(pending_glyphs);
+            pending = false;
+            started = generation;
+        }
+
+        FT_Set_Var_Design_Coordinates(face, result.coords.size(), result.coords.data());
+
+        std::vector<unsigned int> flattened;
+        bool interrupted = false;
+        for (unsigned int glyph_index : result.glyph_indices) {
+            FlattenedGlyph glyph;
+            if (flatten_glyph(face, glyph_index, base_tolerance, simplify, glyph) == GlyphStatus::Ok) {
+                flattened.push_back(glyph_index);
+                result.glyphs.push_back(std::move(glyph));
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (generation != started) {
+                interrupted = true;
+                break;
+            }
+        }
+        if (interrupted) continue;
+
+        result.glyph_indices = std::move(flattened);
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = std::move(result);
+        has_result = true;
+    }
+}
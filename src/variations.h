@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include "glyph_cache.h"
+
+class MappedFile;
+
+struct VariationAxis {
+    std::string name;
+    FT_ULong tag;
+    float minimum, default_value, maximum;
+};
+
+// Design axes of a variable font, empty for static fonts
+std::vector<VariationAxis> variation_axes(FT_Face face);
+
+// Normalized coordinates in [-1, 1] of the instance at the given design
+// coordinates (16.16, empty for the default instance), avar mapping
+// included. The coordinates of the face are left as they were.
+std::vector<float> normalized_coords(FT_Face face, const std::vector<FT_Fixed>& design);
+
+struct InstanceResult {
+    std::vector<FT_Fixed> coords;
+    std::vector<unsigned int> glyph_indices;
+    std::vector<FlattenedGlyph> glyphs;
+};
+
+// Flattens the glyphs on screen for another instance of a variable font on
+// a background thread, with its own FreeType face. Only the latest request
+// matters while an axis is dragged, so a new request replaces the pending
+// one and interrupts the one being flattened.
+class InstanceWorker {
+public:
+    InstanceWorker();
+    ~InstanceWorker();
+
+    InstanceWorker(const InstanceWorker&) = delete;
+    InstanceWorker& operator=(const InstanceWorker&) = delete;
+
+    // Returns false if the font cannot be opened, the file must stay mapped while the worker runs
+    bool open(const MappedFile& font, unsigned int face_index, bool simplify);
+
+    void request(const std::vector<FT_Fixed>& coords, const std::vector<unsigned int>& glyph_indices);
+    // Takes the last finished instance, returns false if there is none
+    bool poll(InstanceResult& result);
+
+private:
+    void run();
+
+    FT_Library ft_lib;
+    FT_Face face;
+    bool simplify;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool pending, has_result, done;
+    unsigned int generation;  // incremented by every request
+    std::vector<FT_Fixed> pending_coords;
+    std::vector<unsigned int> pending_glyphs;
+    InstanceResult finished;
+    std::thread thread;
+};
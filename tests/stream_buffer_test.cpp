@@ -0,0 +1,83 @@
+// Writes to the stream ring across frames and checks that every offset
+// returned in a frame still holds its data once the frame is done, in
+// particular when a write grows the buffer while the ring is on a section
+// other than the first.
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "gl_extensions.h"
+#include "glad.h"
+#include "offscreen.h"
+#include "stream_buffer.h"
+
+// skipped by ctest when there is no GL context to run on
+static const int skip_code = 77;
+
+struct Write {
+    size_t offset;
+    std::vector<unsigned char> data;
+};
+
+static Write write_pattern(StreamBuffer& stream, size_t size, unsigned char seed) {
+    Write write{0, std::vector<unsigned char>(size)};
+    for (size_t i = 0; i < size; i++) {
+        write.data[i] = (unsigned char)(seed + i * 7);
+    }
+    write.offset = stream.write(write.data.data(), size);
+    return write;
+}
+
+static bool check(const StreamBuffer& stream, const std::vector<Write>& writes, const char* name) {
+    glBindBuffer(GL_COPY_READ_BUFFER, stream.buffer());
+    bool ok = true;
+    for (size_t i = 0; i < writes.size(); i++) {
+        std::vector<unsigned char> read(writes[i].data.size());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, writes[i].offset, read.size(), read.data());
+        if (read != writes[i].data) {
+            std::cerr << name << ": write " << i << " at offset " << writes[i].offset << " was not kept" << std::endl;
+            ok = false;
+        }
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return ok;
+}
+
+// Three frames fill the sections in turn, the second write of the last frame outgrows its section
+static bool run(const char* name) {
+    const size_t section_size = 256;
+    StreamBuffer stream(section_size);
+    bool ok = true;
+
+    for (int frame = 0; frame < 4; frame++) {
+        std::vector<Write> writes;
+        writes.push_back(write_pattern(stream, 48, (unsigned char)(frame * 16)));
+        size_t grown = frame == 3 ? 4 * section_size : 32;
+        writes.push_back(write_pattern(stream, grown, (unsigned char)(frame * 16 + 1)));
+        writes.push_back(write_pattern(stream, 40, (unsigned char)(frame * 16 + 2)));
+        ok = check(stream, writes, name) && ok;
+        stream.finishFrame();
+    }
+    // the frames after the growth start on sections of the new size
+    std::vector<Write> writes{write_pattern(stream, 64, 200)};
+    ok = check(stream, writes, name) && ok;
+    stream.finishFrame();
+    return ok;
+}
+
+int main() {
+    if (!init_offscreen_gl()) return skip_code;
+
+    bool ok = true;
+    if (gl_ext.buffer_storage) {
+        ok = run("persistent") && ok;
+        gl_ext.buffer_storage = false;
+    }
+    ok = run("mapped per write") && ok;
+
+    terminate_offscreen_gl();
+    if (!ok) return 1;
+    std::cout << "Stream buffer offsets are kept" << std::endl;
+    return 0;
+}